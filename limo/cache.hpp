@@ -28,11 +28,31 @@ SOFTWARE.
 
 // include local:
 #include <limo/cache/LRU.hpp>
+#include <limo/cache/ARC.hpp>
+#include <limo/cache/Clock.hpp>
+#include <limo/cache/GreedyDualSize.hpp>
+#include <limo/cache/IntrusiveLRU.hpp>
+#include <limo/cache/LFU.hpp>
+#include <limo/cache/TwoQ.hpp>
+#include <limo/cache/WTinyLFU.hpp>
+#include <limo/cache/Snapshot.hpp>
+#include <limo/cache/Statistics.hpp>
+#include <limo/cache/Storage.hpp>
+#include <limo/cache/TimingWheel.hpp>
 #include <limo/assert.hpp>
 
 // include std:
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <functional>
+#include <ostream>
+#include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 // forward declarations:
 
@@ -42,59 +62,293 @@ SOFTWARE.
 namespace limo
 {
 
+// what an entry costs the cache: weight counts against the capacity, 
+// cost is the time its computation took, in seconds
+struct entry_cost
+{
+    std::size_t weight;
+    double      cost;
+};
+
+namespace details
+{
+    // strategy provides `void touch(order_info) const`, safe to call 
+    // concurrently: hits can be served without exclusive access
+    template <class TStrategy, class = void>
+    struct has_concurrent_touch : std::false_type {};
+
+    template <class TStrategy>
+    struct has_concurrent_touch<TStrategy, decltype(
+        std::declval<const TStrategy&>().touch(std::declval<typename TStrategy::order_info>()), 
+        void())> : std::true_type {};
+
+    // strategy provides `pop(const key_type& incoming)`
+    template <class TStrategy, class = void>
+    struct has_pop_for : std::false_type {};
+
+    template <class TStrategy>
+    struct has_pop_for<TStrategy, decltype(
+        std::declval<TStrategy&>().pop(std::declval<const typename TStrategy::key_type&>()), 
+        void())> : std::true_type {};
+
+    template <class TStrategy>
+    decltype(auto) pop_for(TStrategy& strategy, const typename TStrategy::key_type& incoming, std::true_type)
+    {
+        return strategy.pop(incoming);
+    }
+
+    template <class TStrategy>
+    decltype(auto) pop_for(TStrategy& strategy, const typename TStrategy::key_type&, std::false_type)
+    {
+        return strategy.pop();
+    }
+
+    // strategy provides `erase(order_info)`
+    template <class TStrategy, class = void>
+    struct has_erase : std::false_type {};
+
+    template <class TStrategy>
+    struct has_erase<TStrategy, decltype(
+        std::declval<TStrategy&>().erase(std::declval<typename TStrategy::order_info>()), 
+        void())> : std::true_type {};
+
+    template <class TStrategy>
+    void erase_for(TStrategy& strategy, typename TStrategy::order_info x, std::true_type)
+    {
+        strategy.erase(x);
+    }
+
+    template <class TStrategy>
+    void erase_for(TStrategy&, typename TStrategy::order_info, std::false_type)
+    {
+        limo_assert(false, "strategy can not erase, entries should not expire");
+    }
+
+    // strategy provides `for_each(f) const`
+    template <class TStrategy, class = void>
+    struct has_for_each : std::false_type {};
+
+    template <class TStrategy>
+    struct has_for_each<TStrategy, decltype(
+        std::declval<const TStrategy&>().for_each(
+            std::declval<void(*)(const typename TStrategy::key_type&)>()), 
+        void())> : std::true_type {};
+
+    // strategy provides `push(const key_type&, const entry_cost&)`
+    template <class TStrategy, class = void>
+    struct has_cost_push : std::false_type {};
+
+    template <class TStrategy>
+    struct has_cost_push<TStrategy, decltype(
+        std::declval<TStrategy&>().push(
+            std::declval<const typename TStrategy::key_type&>(), std::declval<const entry_cost&>()), 
+        void())> : std::true_type {};
+
+    template <class TStrategy>
+    decltype(auto) push_for(TStrategy& strategy, const typename TStrategy::key_type& key, const entry_cost& cost, std::true_type)
+    {
+        return strategy.push(key, cost);
+    }
+
+    template <class TStrategy>
+    decltype(auto) push_for(TStrategy& strategy, const typename TStrategy::key_type& key, const entry_cost&, std::false_type)
+    {
+        return strategy.push(key);
+    }
+
+    // strategy provides `promote(order_info, const entry_cost&)`
+    template <class TStrategy, class = void>
+    struct has_cost_promote : std::false_type {};
+
+    template <class TStrategy>
+    struct has_cost_promote<TStrategy, decltype(
+        std::declval<TStrategy&>().promote(
+            std::declval<typename TStrategy::order_info>(), std::declval<const entry_cost&>()), 
+        void())> : std::true_type {};
+
+    template <class TStrategy>
+    decltype(auto) promote_for(TStrategy& strategy, typename TStrategy::order_info x, const entry_cost& cost, std::true_type)
+    {
+        return strategy.promote(x, cost);
+    }
+
+    template <class TStrategy>
+    decltype(auto) promote_for(TStrategy& strategy, typename TStrategy::order_info x, const entry_cost&, std::false_type)
+    {
+        return strategy.promote(x);
+    }
+
+    inline double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
 
-template <typename TKey, typename TValue, class TCacheStrategy = LRU<TKey> >
+} // namespace details
+
+
+// CacheStrategy contract:
+//  order_info                  per entry handle, kept in the cache line
+//  key_type
+//  clear()
+//  promote(order_info)         entry was hit, returns its new handle
+//  push(const key_type&)       entry was inserted, the key reference stays 
+//                              valid until the entry is popped
+//  pop()                       evicts one entry, returns its key
+// optional:
+//  pop(const key_type&)        evicts to make room for the given key, which
+//                              is pushed next (ghost lists: ARC)
+//  touch(order_info) const     thread safe hit marking (Clock)
+//  push(const key_type&, const entry_cost&)
+//                              cost aware insertion (GreedyDualSize)
+//  promote(order_info, const entry_cost&)
+//                              value replaced by insert(), with its new 
+//                              weight and cost (GreedyDualSize)
+//  erase(order_info)           drops an entry the cache removes by itself,
+//                              required for expiry (set_ttl)
+//  for_each(f) const           calls f(key) in eviction order, next victim
+//                              first: snapshots keep the order (save)
+//
+// With a transparent hash and equality (StringHash, StringEqual) find(), 
+// operator[], lookup() and contains() accept any key type they take: 
+// the key is built on a miss only. NodeStorage still converts on lookup,
+// std::unordered_map has no heterogeneous find before C++20.
+
+template <
+    typename TKey, 
+    typename TValue, 
+    class TCacheStrategy = LRU<TKey>, 
+    class TStorage = NodeStorage,
+    class THash = std::hash<TKey>,
+    class TEqual = std::equal_to<TKey> >
 class Cache 
 {
 public: 
-    typedef Cache<TKey, TValue, TCacheStrategy> self_type;
+    typedef Cache<TKey, TValue, TCacheStrategy, TStorage, THash, TEqual> self_type;
     
     typedef std::size_t size_type;
     typedef TKey        key_type;
     typedef TValue      cached_type;
 
     typedef std::function<cached_type(const key_type&)> computor_type;
+    typedef std::function<std::vector<cached_type>(const std::vector<key_type>&)> 
+                                                        bulk_computor_type;
+    typedef std::function<size_type(const key_type&, const cached_type&)> 
+                                                        weigher_type;
+    typedef std::function<void(const key_type&, cached_type&&)> 
+                                                        eviction_listener_type;
 
     typedef TCacheStrategy                              strategy_type;
     typedef typename strategy_type::order_info          order_info;
     
-    typedef std::pair<cached_type, order_info>          cache_line;
-    typedef std::unordered_map<key_type, cache_line>    cache_map;
-
-    struct statistics_type
+    typedef TStorage                                    storage_type;
+    typedef THash                                       hasher;
+    typedef TEqual                                      key_equal;
+
+    // lookups by other key types: enabled with a transparent hash and equality
+    template <class TOther>
+    using if_transparent = typename std::enable_if<
+        details::is_transparent<hasher, key_equal>::value && 
+        !std::is_same<TOther, key_type>::value>::type;
+
+    typedef std::chrono::steady_clock                   clock_type;
+    typedef clock_type::duration                        duration;
+    typedef TimingWheel<key_type, clock_type>           timing_wheel;
+    typedef typename timing_wheel::index_type           timer_type;
+
+    struct cache_line
     {
-        size_type hits;
-        size_type misses;
+        cached_type value;
+        order_info  info;
+        size_type   weight;
+        timer_type  timer;      // timing_wheel::npos: never expires
     };
 
+    typedef typename storage_type::template map_type<
+        key_type, cache_line, hasher, key_equal> cache_map;
+
+    typedef CacheStatistics                             statistics_type;
+
     
 public: // ctors
     Cache(
         computor_type           computor, 
         size_type               capacity, 
-        const strategy_type&    strategy = strategy_type()
+        strategy_type           strategy = strategy_type()
+    )
+    : Cache(computor, bulk_computor_type(), capacity, std::move(strategy))
+    {
+    }
+
+    // get_many() hands all its misses to bulk_computor in one call
+    Cache(
+        computor_type           computor, 
+        bulk_computor_type      bulk_computor, 
+        size_type               capacity, 
+        strategy_type           strategy = strategy_type()
     )
     : m_cache()
     , m_compute(computor)
+    , m_bulk_compute(bulk_computor)
+    , m_weigher()
+    , m_on_evict()
     , m_capacity(capacity)
-    , m_strategy(strategy)
+    , m_expected_size(capacity)
+    , m_strategy(std::move(strategy))
+    , m_wheel()
+    , m_ttl(duration::zero())
     , m_stat()
     {
         limo_scope_invariant(is_valid());
     }
 
     ~Cache() = default;
-    Cache(const self_type&) = default;
+
+    // strategy handles and timers refer to the source, the copy pushes 
+    // and schedules its entries again: their eviction order starts anew
+    Cache(const self_type& other)
+    : m_cache(other.m_cache)
+    , m_compute(other.m_compute)
+    , m_bulk_compute(other.m_bulk_compute)
+    , m_weigher(other.m_weigher)
+    , m_on_evict(other.m_on_evict)
+    , m_capacity(other.m_capacity)
+    , m_expected_size(other.m_expected_size)
+    , m_strategy(other.m_strategy)
+    , m_wheel(other.m_wheel.resolution())
+    , m_ttl(other.m_ttl)
+    , m_stat(other.m_stat)
+    {
+        m_strategy.clear();
+        for(auto& x : m_cache)
+        {
+            x.second.info = details::push_for(m_strategy, x.first, entry_cost{x.second.weight, 0}, 
+                details::has_cost_push<strategy_type>());
+            if (x.second.timer != timing_wheel::npos)
+                x.second.timer = m_wheel.schedule(x.first, other.m_wheel.deadline(x.second.timer));
+        }
+    }
+
     Cache(self_type&&) = default;
-    self_type& operator=(const self_type&) = default;
     self_type& operator=(self_type&&) = default;
 
+    self_type& operator=(const self_type& other)
+    {
+        self_type(other).swap(*this);
+        return *this;
+    }
+
     void swap(self_type& other) // nothrow swap for O(1)
     {
         std::swap(m_cache, other.m_cache);
         std::swap(m_compute, other.m_compute);
+        std::swap(m_bulk_compute, other.m_bulk_compute);
+        std::swap(m_weigher, other.m_weigher);
+        std::swap(m_on_evict, other.m_on_evict);
         std::swap(m_capacity, other.m_capacity);
+        std::swap(m_expected_size, other.m_expected_size);
         std::swap(m_strategy, other.m_strategy);
+        m_wheel.swap(other.m_wheel);
+        std::swap(m_ttl, other.m_ttl);
         std::swap(m_stat, other.m_stat);
     }
 
@@ -103,50 +357,478 @@ public: // state
     bool        empty()     const   { return size() == 0; }
     size_type   size()      const   { return m_cache.size(); }
     size_type   capacity()  const   { return m_capacity; }
+    size_type   weight()    const   { return m_stat.weight.get(); }
+
+    // snapshot of the counters, safe to take from other threads while 
+    // the cache is in use: counters are relaxed atomics
+    statistics_type statistics() const { return m_stat.snapshot(); }
+    const strategy_type&   strategy()   const { return m_strategy; }
+
+    bool contains(const key_type& key) const 
+    { 
+        return contains_key(key); 
+    }
 
-    float       hit_ratio() const   { return float(m_stat.hits)/(m_stat.hits+m_stat.misses()); }
+    template <class TOther, class = if_transparent<TOther> >
+    bool contains(const TOther& key) const 
+    { 
+        return contains_key(key); 
+    }
+
+    float hit_ratio() const 
+    { 
+        const size_type hits = m_stat.hits.get();
+        const size_type total = hits + m_stat.misses.get();
+        return total ? float(hits)/total : 0.f; 
+    }
+
+    // capacity and weight() are measured by the weigher, every entry
+    // weighs 1 without it. Set it while the cache is empty. The storage
+    // is then reserved for expected_size entries, not the capacity, and
+    // grows on demand past it.
+    void set_weigher(weigher_type weigher, size_type expected_size = 0)
+    {
+        limo_contract(empty(), "entries are already weighed");
+        m_weigher = std::move(weigher);
+        m_expected_size = expected_size;
+    }
+
+    // time to live of the entries inserted from now on, zero: forever.
+    // Expired entries are dropped by a timing wheel as time goes on and 
+    // count as misses when looked up before that.
+    void set_ttl(duration ttl)
+    {
+        static_assert(details::has_erase<strategy_type>::value, 
+            "strategy has no erase(), entries can not expire");
+        m_ttl = ttl;
+    }
+
+    duration ttl() const { return m_ttl; }
+
+    // gets the entries evicted for room, with their values moved out: a
+    // lower tier may keep them (see TieredCache). Expiry and clear() do 
+    // not call it.
+    void set_eviction_listener(eviction_listener_type listener)
+    {
+        m_on_evict = std::move(listener);
+    }
 
 public: // main interface
 
     void clear()
     {
         m_cache.clear();
+        m_wheel.clear();
+        m_stat.weight.set(0);
         m_strategy.clear();
-        m_stat = statistics_type{};   
+        m_stat.clear();
+    }
+
+    // lookup without insertion for strategies with a concurrent touch(): 
+    // marks the hit in the strategy, does not change the map or the
+    // statistics, so concurrent calls are safe. nullptr on miss.
+    const cached_type* find(const key_type& key) const
+    {
+        return find_value(key);
+    }
+
+    template <class TOther, class = if_transparent<TOther> >
+    const cached_type* find(const TOther& key) const
+    {
+        return find_value(key);
     }
 
     cached_type& operator[](const key_type& key) 
     {
-        limo_scope_invariant(is_valid());
+        return get_value(key);
+    }
+
+    template <class TOther, class = if_transparent<TOther> >
+    cached_type& operator[](const TOther& key) 
+    {
+        return get_value(key);
+    }
+
+    // hit: promotes the entry and returns its value, miss: nullptr.
+    // Counted in statistics either way, nothing is computed.
+    cached_type* lookup(const key_type& key)
+    {
+        return lookup_value(key);
+    }
+
+    template <class TOther, class = if_transparent<TOther> >
+    cached_type* lookup(const TOther& key)
+    {
+        return lookup_value(key);
+    }
+
+    // stores a value computed elsewhere, replaces the existing one.
+    // cost is the computation time, it goes to the load statistics and to 
+    // cost aware strategies. A replaced value that weighs more evicts 
+    // other entries until the weight fits again.
+    cached_type& insert(const key_type& key, cached_type value, double cost = 0)
+    {
+        return insert(key, std::move(value), m_ttl, cost);
+    }
+
+    // same with its own time to live
+    cached_type& insert(const key_type& key, cached_type value, duration ttl, double cost = 0)
+    {
+        limo_contract(ttl == duration::zero() || details::has_erase<strategy_type>::value, 
+            "strategy has no erase(), entries can not expire");
+        expire();
+        if (cost > 0)
+            m_stat.record_load(cost);
 
         typename cache_map::iterator x = m_cache.find(key);
-        bool cache_hit = x != m_cache.end();
-        if (cache_hit)
+        if (x == m_cache.end())
+            return insert_new(key, std::move(value), ttl, cost)->second.value;
+
+        const size_type weight = weigh(key, value);
+        m_stat.weight.set(m_stat.weight.get() - x->second.weight + weight);
+        x->second.weight = weight;
+        x->second.value = std::move(value);
+        if (this->weight() > capacity())
+            make_room(x, cost, details::has_erase<strategy_type>());
+        else
+            x->second.info = details::promote_for(m_strategy, x->second.info, entry_cost{weight, cost}, 
+                details::has_cost_promote<strategy_type>());
+        schedule(x, ttl);
+        return x->second.value;
+    }
+
+    // values of [first, last) in order. Misses are collected first and 
+    // computed by one bulk computor call (one by one without it); keys 
+    // of the batch evicted by the batch itself are computed again.
+    template <class TInputIterator, class TOutputIterator>
+    TOutputIterator get_many(TInputIterator first, TInputIterator last, TOutputIterator out)
+    {
+        limo_scope_invariant(is_valid());
+        expire();
+
+        const std::vector<key_type> keys(first, last);
+        const size_type prefetch_distance = 8;
+
+        std::unordered_map<key_type, size_type, hasher, key_equal> missing_index;
+        std::vector<key_type> missing;
+        for(size_type i = 0; i < keys.size(); ++i)
         {
-            ++m_stat.hits;
-            x->second.second = m_strategy.promote(x->second.second);
+            if (i + prefetch_distance < keys.size())
+                storage_type::prefetch(m_cache, keys[i + prefetch_distance]);
+
+            typename cache_map::const_iterator x = m_cache.find(keys[i]);
+            if ((x == m_cache.end() || is_expired(x->second)) && 
+                missing_index.insert(std::make_pair(keys[i], missing.size())).second)
+            {
+                missing.push_back(keys[i]);
+            }
         }
-        else 
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<cached_type> computed;
+        if (m_bulk_compute && !missing.empty())
         {
-            ++m_stat.misses;
+            computed = m_bulk_compute(missing);
+            limo_contract(computed.size() == missing.size(), "bulk computor should return value per key");
+        }
+        else
+        {
+            computed.reserve(missing.size());
+            for(const auto& key : missing)
+                computed.push_back(m_compute(key));
+        }
+        const double cost = missing.empty() ? 0 : details::seconds_since(start) / missing.size();
+        for(size_type i = 0; i < missing.size(); ++i)
+            m_stat.record_load(cost);
 
-            if(size() == capacity()) {
-                m_cache.erase(m_strategy.pop());
+        for(const auto& key : keys)
+        {
+            if (cached_type* value = lookup(key))
+            {
+                *out++ = *value;
+                continue;
             }
-            
-            auto line_info = m_strategy.push(key);
-            auto result = m_cache.insert(
-                    std::make_pair(key, cache_line(m_compute(key), line_info)));
 
-            limo_assert(result.second, "key should not be there, it's miss branch");
-            x = result.first;
+            auto x = missing_index.find(key);
+            *out++ = x != missing_index.end() 
+                ? insert_new(key, computed[x->second], m_ttl, cost)->second.value
+                : compute(key)->second.value;
         }
+        return out;
+    }
+
+    // writes the entries to a binary file, keys and values encoded by 
+    // snapshot_traits. With a strategy that has for_each() they go in 
+    // eviction order, so load() restores it: recency survives, frequencies,
+    // ghosts and deadlines start anew. false on io errors.
+    bool save(const std::string& path) const
+    {
+        entries_type entries;
+        entries.reserve(size());
+        collect(entries, details::has_for_each<strategy_type>());
 
-        return x->second.first;
+        // written aside and renamed: a crash never leaves half a snapshot
+        const std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            const auto header = details::snapshot_header::make<key_type, cached_type>(entries.size());
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            for(const auto& x : entries)
+            {
+                snapshot_traits<key_type>::write(out, x->first);
+                snapshot_traits<cached_type>::write(out, x->second.value);
+            }
+            out.flush();
+            if (!out)
+            {
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    // replaces the contents with a snapshot written by save(), the file is
+    // mapped and decoded in place. Entries over the capacity evict older 
+    // ones as usual. false if the file is missing, truncated or holds 
+    // other types; the cache is left empty then.
+    bool load(const std::string& path)
+    {
+        clear();
+
+        const details::MappedFile file(path);
+        details::snapshot_header header;
+        if (!file || std::size_t(file.end() - file.begin()) < sizeof(header))
+            return false;
+
+        std::memcpy(&header, file.begin(), sizeof(header));
+        if (!header.matches<key_type, cached_type>())
+            return false;
+
+        const char* cursor = file.begin() + sizeof(header);
+        key_type key;
+        cached_type value;
+        for(std::uint64_t i = 0; i < header.count; ++i)
+        {
+            if (!snapshot_traits<key_type>::read(cursor, file.end(), key) ||
+                !snapshot_traits<cached_type>::read(cursor, file.end(), value))
+            {
+                clear();
+                return false;
+            }
+            insert(key, std::move(value));
+        }
+        return true;
     }
 
 private: // implementation details
 
+    template <class TOther>
+    bool contains_key(const TOther& key) const
+    {
+        typename cache_map::const_iterator x = storage_type::find(m_cache, key);
+        return x != m_cache.end() && !is_expired(x->second); 
+    }
+
+    template <class TOther>
+    const cached_type* find_value(const TOther& key) const
+    {
+        static_assert(details::has_concurrent_touch<strategy_type>::value, 
+            "strategy has no concurrent touch()");
+
+        typename cache_map::const_iterator x = storage_type::find(m_cache, key);
+        if (x == m_cache.end() || is_expired(x->second))
+            return nullptr;
+
+        m_strategy.touch(x->second.info);
+        return &x->second.value;
+    }
+
+    // the key is built (if it is of another type) on a miss only
+    template <class TOther>
+    cached_type& get_value(const TOther& key)
+    {
+        limo_scope_invariant(is_valid());
+
+        if (cached_type* value = lookup_value(key))
+            return *value;
+
+        return compute(details::as_key<key_type>(key))->second.value;
+    }
+
+    template <class TOther>
+    cached_type* lookup_value(const TOther& key)
+    {
+        expire();
+
+        typename cache_map::iterator x = storage_type::find(m_cache, key);
+        if (x != m_cache.end() && is_expired(x->second))
+        {
+            // within the last tick of the wheel
+            m_wheel.cancel(x->second.timer);
+            drop_expired(x);
+            x = m_cache.end();
+        }
+
+        if (x == m_cache.end())
+        {
+            m_stat.misses.add();
+            return nullptr;
+        }
+
+        m_stat.hits.add();
+        x->second.info = m_strategy.promote(x->second.info);
+        return &x->second.value;
+    }
+
+    typedef std::vector<typename cache_map::const_iterator> entries_type;
+
+    void collect(entries_type& entries, std::true_type) const
+    {
+        m_strategy.for_each([this, &entries](const key_type& key) {
+            typename cache_map::const_iterator x = m_cache.find(key);
+            if (x != m_cache.end() && !is_expired(x->second))
+                entries.push_back(x);
+        });
+    }
+
+    void collect(entries_type& entries, std::false_type) const
+    {
+        for(typename cache_map::const_iterator x = m_cache.begin(); x != m_cache.end(); ++x)
+        {
+            if (!is_expired(x->second))
+                entries.push_back(x);
+        }
+    }
+
+    size_type weigh(const key_type& key, const cached_type& value) const
+    {
+        return m_weigher ? m_weigher(key, value) : 1;
+    }
+
+    typename cache_map::iterator compute(const key_type& key)
+    {
+        const auto start = clock_type::now();
+        cached_type value = m_compute(key);
+        const double seconds = details::seconds_since(start);
+        m_stat.record_load(seconds);
+        return insert_new(key, std::move(value), m_ttl, seconds);
+    }
+
+    // an entry heavier than the capacity evicts everything else
+    typename cache_map::iterator insert_new(const key_type& key, cached_type value, duration ttl, double cost)
+    {
+        const size_type weight = weigh(key, value);
+        while(!empty() && this->weight() + weight > capacity()) {
+            evict(key);
+        }
+
+        // on the first insertion: the weigher may change what to expect
+        if (empty())
+            storage_type::reserve(m_cache, m_expected_size);
+        
+        auto result = m_cache.insert(
+                std::make_pair(key, cache_line{std::move(value), order_info(), weight, timing_wheel::npos}));
+
+        limo_assert(result.second, "key should not be there, it's miss branch");
+        typename cache_map::iterator x = result.first;
+        m_stat.weight.add(weight);
+        m_stat.inserts.add();
+
+        // strategy gets the key owned by the map: nodes are stable
+        x->second.info = details::push_for(m_strategy, x->first, entry_cost{weight, cost}, 
+            details::has_cost_push<strategy_type>());
+        schedule(x, ttl);
+        return x;
+    }
+
+    void schedule(typename cache_map::iterator x, duration ttl)
+    {
+        if (x->second.timer != timing_wheel::npos)
+            m_wheel.cancel(x->second.timer);
+
+        x->second.timer = ttl == duration::zero() 
+            ? timing_wheel::npos
+            : m_wheel.schedule(x->first, clock_type::now() + ttl);
+    }
+
+    bool is_expired(const cache_line& x) const
+    {
+        return x.timer != timing_wheel::npos && m_wheel.deadline(x.timer) <= clock_type::now();
+    }
+
+    // drops the entries whose time is over, O(1) per entry
+    void expire()
+    {
+        if (m_wheel.empty())
+            return;
+
+        m_wheel.advance(clock_type::now(), [this](const key_type& key) {
+            drop_expired(m_cache.find(key));
+        });
+    }
+
+    // the timer of the entry is already canceled
+    void drop_expired(typename cache_map::iterator x)
+    {
+        details::erase_for(m_strategy, x->second.info, details::has_erase<strategy_type>());
+        m_stat.weight.sub(x->second.weight);
+        m_stat.expired.add();
+        m_cache.erase(x);
+    }
+
+    // the entry x got heavier: evicts the others until the weight fits,
+    // x is out of the strategy meanwhile and comes back as just inserted
+    void make_room(typename cache_map::iterator x, double cost, std::true_type)
+    {
+        m_strategy.erase(x->second.info);
+        while(size() > 1 && weight() > capacity()) {
+            evict(x->first);
+        }
+        x->second.info = details::push_for(m_strategy, x->first, entry_cost{x->second.weight, cost}, 
+            details::has_cost_push<strategy_type>());
+    }
+
+    // without erase() x is promoted first; if the strategy still picks 
+    // it, it is pushed back and the weight is settled by later evictions
+    void make_room(typename cache_map::iterator x, double cost, std::false_type)
+    {
+        x->second.info = details::promote_for(m_strategy, x->second.info, entry_cost{x->second.weight, cost}, 
+            details::has_cost_promote<strategy_type>());
+        while(size() > 1 && weight() > capacity())
+        {
+            typename cache_map::iterator victim = m_cache.find(
+                details::pop_for(m_strategy, x->first, details::has_pop_for<strategy_type>()));
+            if (victim == x)
+            {
+                x->second.info = details::push_for(m_strategy, x->first, entry_cost{x->second.weight, cost}, 
+                    details::has_cost_push<strategy_type>());
+                return;
+            }
+            drop_evicted(victim);
+        }
+    }
+
+    void evict(const key_type& incoming)
+    {
+        // pop() may return a reference to the key stored in the map, 
+        // so find first and erase by iterator
+        drop_evicted(m_cache.find(
+            details::pop_for(m_strategy, incoming, details::has_pop_for<strategy_type>())));
+    }
+
+    void drop_evicted(typename cache_map::iterator victim)
+    {
+        limo_assert(victim != m_cache.end(), "strategy popped unknown key");
+        if (victim->second.timer != timing_wheel::npos)
+            m_wheel.cancel(victim->second.timer);
+        m_stat.weight.sub(victim->second.weight);
+        m_stat.evictions.add();
+        if (m_on_evict)
+            m_on_evict(victim->first, std::move(victim->second.value));
+        m_cache.erase(victim);
+    }
+
     bool is_valid() const
     {
         return true;
@@ -160,7 +842,7 @@ private: // implementation details
             << "\telements: [";
         for(const auto& x : cache.m_cache)
         {
-            o << "(" << x.first << "," << x.second.first << "), ";
+            o << "(" << x.first << "," << x.second.value << "), ";
         }
         
         // o   << std::endl << "\tstrategy: " << cache.m_order;
@@ -169,11 +851,17 @@ private: // implementation details
 
 private:
     
-    cache_map       m_cache;
-    computor_type   m_compute;
-    size_type       m_capacity;
-    strategy_type   m_strategy;
-    statistics_type m_stat;
+    cache_map               m_cache;
+    computor_type           m_compute;
+    bulk_computor_type      m_bulk_compute;
+    weigher_type            m_weigher;
+    eviction_listener_type  m_on_evict;
+    size_type               m_capacity;
+    size_type               m_expected_size;    // entries, for the storage
+    strategy_type           m_strategy;
+    timing_wheel            m_wheel;
+    duration                m_ttl;
+    details::CacheCounters  m_stat;
 };
 
     
@@ -0,0 +1,277 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/assert.hpp>
+#include <limo/cache/FlatHashMap.hpp>
+
+// include std:
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <list>
+#include <ostream>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+// Adaptive Replacement Cache (Megiddo, Modha). Resident keys are split into
+// T1 (seen once recently) and T2 (seen at least twice); ghost lists B1 and
+// B2 remember keys recently evicted from each of them. A miss on a ghost 
+// shifts the target size p of T1 towards the list that would have kept
+// the key, so the recency/frequency balance adapts to the workload and a 
+// scan can only flush T1. Uses the pop(incoming) form of the contract: 
+// which list to evict from depends on the key being admitted. p adapts
+// once per admission, on its first pop; the pops a weighted cache makes
+// for the same key until it is pushed only choose victims.
+template <typename TKey>
+class ARC 
+{
+public:
+    typedef ARC<TKey>       self_type;
+    typedef std::size_t     size_type;
+
+    enum segment_type { t1, t2, b1, b2 };
+
+    struct node_type
+    {
+        TKey            key;
+        segment_type    segment;
+    };
+
+    typedef std::list<node_type>    order_type;
+
+public: // contract types
+    typedef typename order_type::iterator   order_info;
+    typedef TKey                            key_type;
+
+public: // ctors
+
+    explicit ARC(size_type capacity)
+    : m_capacity(capacity)
+    , m_target(0)
+    , m_adapted(false)
+    , m_ghosts(capacity)
+    {
+    }
+
+    // order_info refers into this instance, copies would share them
+    ARC(const self_type&) = delete;
+    self_type& operator=(const self_type&) = delete;
+    ARC(self_type&&) = default;
+    self_type& operator=(self_type&&) = default;
+
+    void swap(self_type& other)
+    {
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_target, other.m_target);
+        std::swap(m_adapted, other.m_adapted);
+        std::swap(m_lists, other.m_lists);
+        m_ghosts.swap(other.m_ghosts);
+    }
+
+    // target size of T1
+    size_type target() const { return m_target; }
+
+public: // CacheStrategy contract interface
+
+    void clear()
+    {
+        for(auto& x : m_lists)
+            x.clear();
+        m_ghosts.clear();
+        m_target = 0;
+        m_adapted = false;
+    }
+
+    order_info promote(order_info x) 
+    {
+        move_front(x, t2);
+        return x;
+    }
+
+    order_info push(const key_type& key) 
+    {
+        m_adapted = false;
+
+        auto ghost = m_ghosts.find(key);
+        if (ghost != m_ghosts.end())
+        {
+            // re-admission of a recently evicted key, goes to T2
+            order_info x = ghost->second;
+            m_ghosts.erase(ghost);
+            move_front(x, t2);
+            return x;
+        }
+
+        list(t1).push_front(node_type{key, t1});
+        trim_ghosts();
+        return list(t1).begin();
+    }
+
+    key_type pop(const key_type& incoming) 
+    {
+        limo_contract(!list(t1).empty() || !list(t2).empty(), "push/pop call balance broken");
+
+        auto ghost = m_ghosts.find(incoming);
+        const bool in_b1 = ghost != m_ghosts.end() && ghost->second->segment == b1;
+        const bool in_b2 = ghost != m_ghosts.end() && ghost->second->segment == b2;
+
+        if (in_b1 || in_b2)
+        {
+            adapt(in_b1);
+        }
+        else if (list(t1).size() >= m_capacity)
+        {
+            // L1 is all resident: drop its LRU page without remembering it
+            return erase(last(t1));
+        }
+
+        return replace(in_b2);
+    }
+
+    key_type pop() 
+    {
+        return replace(false);
+    }
+
+    key_type erase(order_info x)
+    {
+        key_type key = x->key;
+        list(x->segment).erase(x);
+        return key;
+    }
+
+    // resident keys: T1 then T2, each from its LRU end
+    template <class TFunction>
+    void for_each(TFunction f) const
+    {
+        for(segment_type s : {t1, t2})
+            for(auto x = m_lists[s].rbegin(); x != m_lists[s].rend(); ++x)
+                f(x->key);
+    }
+
+private: // internals
+
+    order_type& list(segment_type s) { return m_lists[s]; }
+
+    order_info last(segment_type s) 
+    { 
+        return std::prev(list(s).end()); 
+    }
+
+    void move_front(order_info x, segment_type to)
+    {
+        list(to).splice(list(to).begin(), list(x->segment), x);
+        x->segment = to;
+    }
+
+    // shifts p towards the ghost list hit by the incoming key, once until 
+    // the next push()
+    void adapt(bool in_b1)
+    {
+        if (m_adapted)
+            return;
+        m_adapted = true;
+
+        if (in_b1)
+        {
+            const size_type delta = std::max<size_type>(1, list(b2).size() / list(b1).size());
+            m_target = std::min(m_capacity, m_target + delta);
+        }
+        else
+        {
+            const size_type delta = std::max<size_type>(1, list(b1).size() / list(b2).size());
+            m_target = m_target > delta ? m_target - delta : 0;
+        }
+    }
+
+    // evicts the LRU of T1 or T2 into the matching ghost list
+    key_type replace(bool incoming_in_b2)
+    {
+        const size_type t1_size = list(t1).size();
+        const bool from_t1 = t1_size > 0 && 
+            (t1_size > m_target || (incoming_in_b2 && t1_size == m_target));
+        
+        const order_info x = from_t1 || list(t2).empty() ? last(t1) : last(t2);
+        move_front(x, x->segment == t1 ? b1 : b2);
+        m_ghosts.insert(std::make_pair(x->key, x));
+        return x->key;
+    }
+
+    // |T1| + |B1| <= c, |T1| + |T2| + |B1| + |B2| <= 2c
+    void trim_ghosts()
+    {
+        while(!list(b1).empty() && list(t1).size() + list(b1).size() > m_capacity)
+            drop_ghost(b1);
+        
+        size_type total = 0;
+        for(const auto& x : m_lists)
+            total += x.size();
+        for(; !list(b2).empty() && total > 2 * m_capacity; --total)
+            drop_ghost(b2);
+    }
+
+    void drop_ghost(segment_type s)
+    {
+        const order_info x = last(s);
+        m_ghosts.erase(x->key);
+        list(s).erase(x);
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, const self_type& order) 
+    {
+        const char* names[] = {"T1", "T2", "B1", "B2"};
+        o << "p=" << order.m_target << " ";
+        for(unsigned s = 0; s < 4; ++s)
+        {
+            o << names[s] << ": [";
+            for(const auto& x : order.m_lists[s]) 
+                o << x.key << ", ";
+            o << "] ";
+        }
+        return o;
+    }
+
+private:
+    size_type                               m_capacity;
+    size_type                               m_target;
+    bool                                    m_adapted;  // by a pop since the last push
+    order_type                              m_lists[4];
+    FlatHashMap<key_type, order_info>       m_ghosts;
+};
+   
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
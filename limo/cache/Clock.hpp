@@ -0,0 +1,214 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/assert.hpp>
+
+// include std:
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+// CLOCK (second chance) eviction. A hit only sets the reference bit of the
+// entry: touch() is a relaxed atomic load, plus a store only if the bit is
+// clear. It is safe to call concurrently with other touch() calls, so 
+// caches may serve hits under a shared lock.
+// The hand sweeps the slots on pop(), clearing bits, and evicts the first 
+// entry not referenced since the previous sweep. Like IntrusiveLRU, slots 
+// point to the keys owned by the cache.
+template <typename TKey>
+class Clock 
+{
+public:
+    typedef Clock<TKey>         self_type;
+    typedef std::uint32_t       index_type;
+    typedef std::size_t         size_type;
+
+public: // contract types
+    typedef index_type  order_info;
+    typedef TKey        key_type;
+    
+public: // ctors
+
+    explicit Clock(size_type capacity = 0)
+    : m_slots()
+    , m_free()
+    , m_hand(0)
+    {
+        m_slots.reserve(capacity);
+    }
+
+    // slots point into the owning cache, copy would leave them dangling
+    Clock(const self_type&) = delete;
+    self_type& operator=(const self_type&) = delete;
+    Clock(self_type&&) = default;
+    self_type& operator=(self_type&&) = default;
+
+    void swap(self_type& other)
+    {
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_free, other.m_free);
+        std::swap(m_hand, other.m_hand);
+    }
+
+public: // CacheStrategy contract interface
+
+    void clear()
+    {
+        m_slots.clear();
+        m_free.clear();
+        m_hand = 0;
+    }
+
+    order_info promote(order_info x) 
+    {
+        touch(x);
+        return x;
+    }
+
+    // thread safe against other touch() calls
+    void touch(order_info x) const
+    {
+        // a hot entry is already marked: read only, its cache line stays 
+        // shared between the cores
+        std::atomic<bool>& referenced = m_slots[x].referenced;
+        if (!referenced.load(std::memory_order_relaxed))
+            referenced.store(true, std::memory_order_relaxed);
+    }
+
+    order_info push(const key_type& key) 
+    {
+        index_type x;
+        if (!m_free.empty())
+        {
+            x = m_free.back();
+            m_free.pop_back();
+        }
+        else
+        {
+            limo_assert(m_slots.size() < index_type(-1), "too many slots");
+            x = index_type(m_slots.size());
+            m_slots.emplace_back();
+        }
+
+        slot& s = m_slots[x];
+        s.key = &key;
+        s.referenced.store(false, std::memory_order_relaxed);
+        return x;
+    }
+    
+    const key_type& pop() 
+    {
+        limo_contract(m_free.size() < m_slots.size(), "push/pop call balance broken");
+
+        for(;; advance())
+        {
+            slot& s = m_slots[m_hand];
+            if (s.key == nullptr)
+                continue;
+            if (s.referenced.exchange(false, std::memory_order_relaxed))
+                continue;
+
+            const key_type& key = *s.key;
+            erase(m_hand);
+            advance();
+            return key;
+        }
+    }
+
+    void erase(order_info x) 
+    {
+        m_slots[x].key = nullptr;
+        m_free.push_back(x);
+    }
+
+    // in the order of the hand, reference bits aside
+    template <class TFunction>
+    void for_each(TFunction f) const
+    {
+        for(size_type i = 0; i < m_slots.size(); ++i)
+        {
+            const slot& s = m_slots[(m_hand + i) % m_slots.size()];
+            if (s.key)
+                f(*s.key);
+        }
+    }
+
+private: // internals
+
+    struct slot
+    {
+        const key_type*             key;    // nullptr for free slots
+        mutable std::atomic<bool>   referenced;
+
+        slot(): key(nullptr), referenced(false) {}
+
+        // relocation on growth only, done under exclusive access
+        slot(slot&& other)
+        : key(other.key)
+        , referenced(other.referenced.load(std::memory_order_relaxed))
+        {
+        }
+    };
+
+    void advance()
+    {
+        if (++m_hand == m_slots.size())
+            m_hand = 0;
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, const self_type& order) 
+    {
+        o << "[";
+        for(const auto& x : order.m_slots) 
+        {
+            if (x.key)
+                o << *x.key << (x.referenced ? "*" : "") << ", ";
+        }
+        return o << "]";
+    }
+
+private:
+    std::vector<slot>       m_slots;
+    std::vector<index_type> m_free;
+    index_type              m_hand;
+};
+   
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,276 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/assert.hpp>
+#include <limo/bases.hpp>
+#include <limo/cache/FlatHashMap.hpp>
+#include <limo/cache/Snapshot.hpp>
+
+// include std:
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+// Log-structured store of cache entries in a memory-mapped scratch file.
+// The file is cut into regions that are filled one after another as a 
+// ring: put() appends the record (key and value encoded by snapshot_traits)
+// to the current region, and when the ring comes round to a used region 
+// its records are dropped from the index, oldest writes first. Nothing is
+// rewritten in place, so writes are sequential; reads are a lookup in the
+// in-memory index and a decode straight from the mapping. The file is 
+// created (truncated) on construction and removed on destruction.
+// Without mmap (Windows) the regions are kept in memory instead.
+template <typename TKey, typename TValue, class THash = std::hash<TKey> >
+class DiskStore : limo::noncopyable
+{
+public:
+    typedef DiskStore<TKey, TValue, THash>  self_type;
+    typedef std::size_t                     size_type;
+    typedef TKey                            key_type;
+    typedef TValue                          value_type;
+
+    struct statistics_type
+    {
+        size_type hits;
+        size_type misses;
+        size_type writes;
+        size_type rejected;     // records larger than a region
+        size_type dropped;      // live records lost to region reuse
+    };
+
+public: // ctors
+
+    // capacity in bytes, rounded down to whole regions
+    DiskStore(const std::string& path, size_type capacity, size_type region_size = size_type(1) << 20)
+    : m_path(path)
+    , m_data(nullptr)
+    , m_region_size(region_size)
+    , m_regions(std::max<size_type>(1, capacity / region_size))
+    , m_used(m_regions, 0)
+    , m_region(0)
+    , m_index()
+    , m_buffer()
+    , m_stat()
+    {
+#if defined(_WIN32)
+        m_memory.resize(m_regions * m_region_size);
+        m_data = m_memory.data();
+#else
+        const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0)
+            return;
+
+        const size_type bytes = m_regions * m_region_size;
+        if (::ftruncate(fd, off_t(bytes)) == 0)
+        {
+            void* data = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (data != MAP_FAILED)
+                m_data = static_cast<char*>(data);
+        }
+        ::close(fd);
+#endif
+    }
+
+    ~DiskStore()
+    {
+#if !defined(_WIN32)
+        if (m_data)
+            ::munmap(m_data, m_regions * m_region_size);
+#endif
+        std::remove(m_path.c_str());
+    }
+
+public: // state
+
+    bool        is_open()   const   { return m_data != nullptr; }
+    bool        empty()     const   { return size() == 0; }
+    size_type   size()      const   { return m_index.size(); }
+    size_type   capacity()  const   { return m_regions * m_region_size; }
+    bool        contains(const key_type& key) const { return m_index.count(key) != 0; }
+
+    const statistics_type& statistics() const { return m_stat; }
+
+public: // interface
+
+    void clear()
+    {
+        m_index.clear();
+        std::fill(m_used.begin(), m_used.end(), 0);
+        m_region = 0;
+    }
+
+    // stores the entry, replaces an older record of the key. 
+    // false if the store is not open or the record does not fit a region
+    bool put(const key_type& key, const value_type& value)
+    {
+        if (!is_open())
+            return false;
+
+        m_buffer.str(std::string());
+        snapshot_traits<key_type>::write(m_buffer, key);
+        const std::uint64_t key_size = std::uint64_t(m_buffer.tellp());
+        snapshot_traits<value_type>::write(m_buffer, value);
+        const std::string payload = m_buffer.str();
+
+        const record_header header = {std::uint32_t(key_size), std::uint32_t(payload.size() - key_size)};
+        const size_type size = sizeof(header) + payload.size();
+        if (size > m_region_size)
+        {
+            ++m_stat.rejected;
+            return false;
+        }
+
+        if (m_used[m_region] + size > m_region_size)
+            next_region();
+
+        const size_type position = m_region * m_region_size + m_used[m_region];
+        std::memcpy(m_data + position, &header, sizeof(header));
+        std::memcpy(m_data + position + sizeof(header), payload.data(), payload.size());
+        m_used[m_region] += size;
+
+        auto x = m_index.find(key);
+        if (x != m_index.end())
+            x->second = position;
+        else
+            m_index.insert(std::make_pair(key, position));
+
+        ++m_stat.writes;
+        return true;
+    }
+
+    bool get(const key_type& key, value_type& value)
+    {
+        auto x = m_index.find(key);
+        if (x == m_index.end() || !decode_value(x->second, value))
+        {
+            ++m_stat.misses;
+            return false;
+        }
+        ++m_stat.hits;
+        return true;
+    }
+
+    // get() and erase(): the entry moves up a tier
+    bool take(const key_type& key, value_type& value)
+    {
+        if (!get(key, value))
+            return false;
+        m_index.erase(key);
+        return true;
+    }
+
+    // the record stays in its region until the region is reused
+    bool erase(const key_type& key)
+    {
+        return m_index.erase(key) != 0;
+    }
+
+private: // internals
+
+    struct record_header
+    {
+        std::uint32_t key_size;
+        std::uint32_t value_size;
+    };
+
+    bool decode_value(size_type position, value_type& value) const
+    {
+        record_header header;
+        std::memcpy(&header, m_data + position, sizeof(header));
+        const char* cursor = m_data + position + sizeof(header) + header.key_size;
+        return snapshot_traits<value_type>::read(cursor, cursor + header.value_size, value);
+    }
+
+    // the next region of the ring, its records leave the index
+    void next_region()
+    {
+        m_region = (m_region + 1) % m_regions;
+
+        const size_type begin = m_region * m_region_size;
+        key_type key;
+        for(size_type position = begin; position < begin + m_used[m_region]; )
+        {
+            record_header header;
+            std::memcpy(&header, m_data + position, sizeof(header));
+            const char* cursor = m_data + position + sizeof(header);
+            const bool decoded = snapshot_traits<key_type>::read(cursor, cursor + header.key_size, key);
+            limo_assert(decoded, "corrupted region");
+
+            // only if this is the latest record of the key
+            auto x = m_index.find(key);
+            if (x != m_index.end() && x->second == position)
+            {
+                m_index.erase(x);
+                ++m_stat.dropped;
+            }
+            position += sizeof(header) + header.key_size + header.value_size;
+        }
+        m_used[m_region] = 0;
+    }
+
+private:
+    std::string                     m_path;
+    char*                           m_data;
+    size_type                       m_region_size;
+    size_type                       m_regions;
+    std::vector<size_type>          m_used;     // bytes per region
+    size_type                       m_region;   // being filled
+    FlatHashMap<key_type, size_type, THash> m_index;    // key: record position
+    std::ostringstream              m_buffer;
+    statistics_type                 m_stat;
+#if defined(_WIN32)
+    std::vector<char>               m_memory;
+#endif
+};
+   
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
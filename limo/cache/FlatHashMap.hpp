@@ -0,0 +1,718 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/assert.hpp>
+#include <limo/cache/TransparentHash.hpp>
+
+// include std:
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define LIMO_FLAT_HASH_SSE2 1
+    #include <emmintrin.h>
+#endif
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+    namespace details
+    {
+        namespace flat
+        {
+            typedef std::int8_t ctrl_type;
+
+            // control byte: full slots keep 7 bits of the hash (h2),
+            // special values have the sign bit set
+            const ctrl_type ctrl_empty   = -128;
+            const ctrl_type ctrl_deleted = -2;
+
+            inline unsigned count_trailing_zeros(std::uint64_t x)
+            {
+            #if defined(__GNUC__)
+                return unsigned(__builtin_ctzll(x));
+            #else
+                unsigned n = 0;
+                for(; !(x & 1); x >>= 1) ++n;
+                return n;
+            #endif
+            }
+
+            inline unsigned count_leading_zeros(std::uint64_t x)
+            {
+            #if defined(__GNUC__)
+                return unsigned(__builtin_clzll(x));
+            #else
+                unsigned n = 0;
+                for(std::uint64_t top = std::uint64_t(1) << 63; !(x & top); x <<= 1) ++n;
+                return n;
+            #endif
+            }
+
+            // set of matching lanes in a group, one bit (or byte) per lane
+            template <unsigned Width, unsigned Shift>
+            class BitMask
+            {
+            public:
+                explicit BitMask(std::uint64_t bits): m_bits(bits) {}
+
+                bool     any()     const { return m_bits != 0; }
+                unsigned lowest()  const { return count_trailing_zeros(m_bits) >> Shift; }
+                void     clear_lowest()  { m_bits &= m_bits - 1; }
+
+                // lanes from the start (trailing) / the end (leading) without a match
+                unsigned trailing_zeros() const 
+                { 
+                    return any() ? lowest() : Width; 
+                }
+                unsigned leading_zeros() const 
+                { 
+                    const unsigned unused = 64 - (Width << Shift);
+                    return any() ? (count_leading_zeros(m_bits) - unused) >> Shift : Width; 
+                }
+
+            private:
+                std::uint64_t m_bits;
+            };
+
+        #if defined(LIMO_FLAT_HASH_SSE2)
+
+            // 16 control bytes compared at once
+            struct Group
+            {
+                static const unsigned width = 16;
+                typedef BitMask<16, 0> mask_type;
+
+                explicit Group(const ctrl_type* pos)
+                : m_ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos)))
+                {}
+
+                mask_type match(ctrl_type h2) const
+                {
+                    return mask_type(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), m_ctrl))));
+                }
+
+                mask_type match_empty() const
+                {
+                    return match(ctrl_empty);
+                }
+
+                mask_type match_empty_or_deleted() const
+                {
+                    return mask_type(unsigned(_mm_movemask_epi8(m_ctrl)));
+                }
+
+                __m128i m_ctrl;
+            };
+
+        #else
+
+            // portable fallback: 8 control bytes in a word (little endian)
+            struct Group
+            {
+                static const unsigned width = 8;
+                typedef BitMask<8, 3> mask_type;
+
+                static const std::uint64_t lsbs = 0x0101010101010101ull;
+                static const std::uint64_t msbs = 0x8080808080808080ull;
+
+                explicit Group(const ctrl_type* pos)
+                {
+                    std::memcpy(&m_ctrl, pos, sizeof(m_ctrl));
+                }
+
+                // may report false positives, keys are compared anyway
+                mask_type match(ctrl_type h2) const
+                {
+                    const std::uint64_t x = m_ctrl ^ (lsbs * std::uint8_t(h2));
+                    return mask_type((x - lsbs) & ~x & msbs);
+                }
+
+                mask_type match_empty() const
+                {
+                    return mask_type(m_ctrl & (~m_ctrl << 6) & msbs);
+                }
+
+                mask_type match_empty_or_deleted() const
+                {
+                    return mask_type(m_ctrl & msbs);
+                }
+
+                std::uint64_t m_ctrl;
+            };
+
+        #endif
+
+            inline std::size_t mix(std::size_t h)
+            {
+                // std::hash of integers is often identity, spread the bits
+                const std::uint64_t x = std::uint64_t(h) * 0x9E3779B97F4A7C15ull;
+                return std::size_t(x ^ (x >> 32));
+            }
+
+        } // namespace flat
+    } // namespace details
+
+
+// Open addressing hash map in the SwissTable layout: a control byte array
+// probed a group at a time (SSE2 where available) and a parallel array of
+// entry indices. Entries live in fixed size blocks and never move, so
+// references and pointers to elements stay valid until the element is 
+// erased, even when the index is rehashed. After reserve(n) no allocation 
+// happens while size() <= n; erased slots are reused.
+template <
+    typename TKey, 
+    typename TMapped, 
+    class THash = std::hash<TKey>, 
+    class TEqual = std::equal_to<TKey> >
+class FlatHashMap
+{
+public:
+    typedef FlatHashMap<TKey, TMapped, THash, TEqual> self_type;
+
+    typedef TKey                                key_type;
+    typedef TMapped                             mapped_type;
+    typedef std::pair<const key_type, mapped_type> value_type;
+    typedef std::size_t                         size_type;
+    typedef THash                               hasher;
+    typedef TEqual                              key_equal;
+
+    // heterogeneous lookup: enabled with a transparent hash and equality
+    template <class TOther>
+    using if_transparent = typename std::enable_if<
+        details::is_transparent<hasher, key_equal>::value && 
+        !std::is_same<TOther, key_type>::value>::type;
+
+private:
+    typedef details::flat::ctrl_type    ctrl_type;
+    typedef details::flat::Group        group_type;
+    typedef std::uint32_t               index_type;
+
+    static const index_type npos = index_type(-1);
+
+    struct slot
+    {
+        std::size_t hash;       // next free slot for unused ones
+        index_type  bucket;     // npos for unused slots
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type data;
+
+        value_type&         value()         { return *reinterpret_cast<value_type*>(&data); }
+        const value_type&   value() const   { return *reinterpret_cast<const value_type*>(&data); }
+    };
+
+    template <bool Const>
+    class basic_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag   iterator_category;
+        typedef typename self_type::value_type value_type;
+        typedef std::ptrdiff_t              difference_type;
+        typedef typename std::conditional<Const, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<Const, const value_type&, value_type&>::type reference;
+        typedef typename std::conditional<Const, const self_type*, self_type*>::type owner_type;
+
+        basic_iterator(): m_owner(nullptr), m_index(0) {}
+        basic_iterator(owner_type owner, index_type index)
+        : m_owner(owner), m_index(index) 
+        { 
+            skip_unused(); 
+        }
+
+        // iterator -> const_iterator
+        template <bool C, class = typename std::enable_if<Const && !C>::type>
+        basic_iterator(const basic_iterator<C>& x): m_owner(x.m_owner), m_index(x.m_index) {}
+
+        reference operator*()  const { return m_owner->entry(m_index).value(); }
+        pointer   operator->() const { return &**this; }
+
+        basic_iterator& operator++()    { ++m_index; skip_unused(); return *this; }
+        basic_iterator  operator++(int) { basic_iterator x = *this; ++*this; return x; }
+
+        friend bool operator==(const basic_iterator& x, const basic_iterator& y) { return x.m_index == y.m_index; }
+        friend bool operator!=(const basic_iterator& x, const basic_iterator& y) { return x.m_index != y.m_index; }
+
+    private:
+        friend class FlatHashMap;
+        template <bool> friend class basic_iterator;
+
+        void skip_unused()
+        {
+            while(m_index < m_owner->m_used && m_owner->entry(m_index).bucket == npos)
+                ++m_index;
+        }
+
+        owner_type  m_owner;
+        index_type  m_index;
+    };
+
+public:
+    typedef basic_iterator<false>   iterator;
+    typedef basic_iterator<true>    const_iterator;
+
+public: // ctors
+    FlatHashMap()
+    : m_ctrl()
+    , m_index()
+    , m_mask(0)
+    , m_growth_left(0)
+    , m_size(0)
+    , m_blocks()
+    , m_block_shift(6)
+    , m_used(0)
+    , m_free(npos)
+    , m_hash()
+    , m_equal()
+    {
+    }
+
+    explicit FlatHashMap(size_type capacity)
+    : FlatHashMap()
+    {
+        reserve(capacity);
+    }
+
+    FlatHashMap(const self_type& other)
+    : FlatHashMap()
+    {
+        m_hash = other.m_hash;
+        m_equal = other.m_equal;
+        reserve(other.size());
+        for(const auto& x : other)
+            insert(x);
+    }
+
+    FlatHashMap(self_type&& other)
+    : FlatHashMap()
+    {
+        swap(other);
+    }
+
+    self_type& operator=(const self_type& other)
+    {
+        if (this != &other)
+        {
+            self_type copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    self_type& operator=(self_type&& other)
+    {
+        self_type moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    ~FlatHashMap()
+    {
+        destroy_all();
+    }
+
+    void swap(self_type& other)
+    {
+        std::swap(m_ctrl, other.m_ctrl);
+        std::swap(m_index, other.m_index);
+        std::swap(m_mask, other.m_mask);
+        std::swap(m_growth_left, other.m_growth_left);
+        std::swap(m_size, other.m_size);
+        std::swap(m_blocks, other.m_blocks);
+        std::swap(m_block_shift, other.m_block_shift);
+        std::swap(m_used, other.m_used);
+        std::swap(m_free, other.m_free);
+        std::swap(m_hash, other.m_hash);
+        std::swap(m_equal, other.m_equal);
+    }
+
+public: // state
+
+    bool        empty()         const   { return m_size == 0; }
+    size_type   size()          const   { return m_size; }
+    size_type   bucket_count()  const   { return m_index.size(); }
+
+    iterator        begin()         { return iterator(this, 0); }
+    iterator        end()           { return iterator(this, m_used); }
+    const_iterator  begin() const   { return const_iterator(this, 0); }
+    const_iterator  end()   const   { return const_iterator(this, m_used); }
+
+public: // main interface
+
+    // preallocates entries and index for n elements
+    void reserve(size_type n)
+    {
+        if (m_blocks.empty())
+        {
+            m_block_shift = 4;
+            while((size_type(1) << m_block_shift) < n)
+                ++m_block_shift;
+        }
+
+        if (n > max_load(bucket_count()) || m_index.empty())
+            rehash(buckets_for(n));
+
+        while(entries_capacity() < n)
+            add_block();
+    }
+
+    void clear()
+    {
+        destroy_all();
+        m_used = 0;
+        m_free = npos;
+        m_size = 0;
+        if (!m_index.empty())
+            reset_ctrl();
+    }
+
+    iterator find(const key_type& key)
+    {
+        return iterator(this, find_entry(key, hash_of(key)));
+    }
+
+    const_iterator find(const key_type& key) const
+    {
+        return const_iterator(this, find_entry(key, hash_of(key)));
+    }
+
+    size_type count(const key_type& key) const
+    {
+        return find(key) != end() ? 1 : 0;
+    }
+
+    template <class TOther, class = if_transparent<TOther> >
+    iterator find(const TOther& key)
+    {
+        return iterator(this, find_entry(key, hash_of(key)));
+    }
+
+    template <class TOther, class = if_transparent<TOther> >
+    const_iterator find(const TOther& key) const
+    {
+        return const_iterator(this, find_entry(key, hash_of(key)));
+    }
+
+    template <class TOther, class = if_transparent<TOther> >
+    size_type count(const TOther& key) const
+    {
+        return find(key) != end() ? 1 : 0;
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value)
+    {
+        return emplace(value);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& value)
+    {
+        return emplace(std::move(value));
+    }
+
+    template <class... TArgs>
+    std::pair<iterator, bool> emplace(TArgs&&... args)
+    {
+        if (m_index.empty())
+            reserve(0);
+
+        index_type x = acquire_entry();
+        slot& s = entry(x);
+        ::new (static_cast<void*>(&s.data)) value_type(std::forward<TArgs>(args)...);
+
+        const std::size_t hash = hash_of(s.value().first);
+        const index_type found = find_entry(s.value().first, hash);
+        if (found != m_used)
+        {
+            s.value().~value_type();
+            release_entry(x);
+            return std::make_pair(iterator(this, found), false);
+        }
+
+        s.hash = hash;
+        insert_index(x, hash);
+        ++m_size;
+        return std::make_pair(iterator(this, x), true);
+    }
+
+    iterator erase(iterator pos)
+    {
+        return erase(const_iterator(pos));
+    }
+
+    iterator erase(const_iterator pos)
+    {
+        const index_type x = pos.m_index;
+        limo_contract(x < m_used && entry(x).bucket != npos, "erasing invalid iterator");
+
+        erase_index(entry(x).bucket);
+        entry(x).value().~value_type();
+        release_entry(x);
+        --m_size;
+        return iterator(this, x + 1);
+    }
+
+    size_type erase(const key_type& key)
+    {
+        const_iterator x = find(key);
+        if (x == end())
+            return 0;
+        erase(x);
+        return 1;
+    }
+
+    // brings the control group of the key into cache ahead of find()
+    template <class TOther>
+    void prefetch(const TOther& key) const
+    {
+    #if defined(__GNUC__)
+        if (!m_index.empty())
+            __builtin_prefetch(&m_ctrl[probe_start(hash_of(key))]);
+    #endif
+    }
+
+private: // implementation details
+
+    static size_type max_load(size_type buckets)
+    {
+        return buckets - buckets / 8;   // 7/8 load factor
+    }
+
+    static size_type buckets_for(size_type n)
+    {
+        size_type buckets = group_type::width;
+        while(max_load(buckets) < n)
+            buckets *= 2;
+        return buckets;
+    }
+
+    template <class TOther>
+    std::size_t hash_of(const TOther& key) const
+    {
+        return details::flat::mix(m_hash(key));
+    }
+
+    static ctrl_type h2(std::size_t hash)  { return ctrl_type(hash & 0x7F); }
+    size_type probe_start(std::size_t hash) const { return (hash >> 7) & m_mask; }
+
+    // entries
+
+    size_type entries_capacity() const 
+    { 
+        return m_blocks.size() << m_block_shift; 
+    }
+
+    slot& entry(index_type x) 
+    { 
+        return m_blocks[x >> m_block_shift][x & ((index_type(1) << m_block_shift) - 1)]; 
+    }
+
+    const slot& entry(index_type x) const
+    { 
+        return m_blocks[x >> m_block_shift][x & ((index_type(1) << m_block_shift) - 1)]; 
+    }
+
+    void add_block()
+    {
+        limo_assert(entries_capacity() + (size_type(1) << m_block_shift) < npos, "too many entries");
+        m_blocks.emplace_back(new slot[size_type(1) << m_block_shift]);
+    }
+
+    index_type acquire_entry()
+    {
+        index_type x = m_free;
+        if (x != npos)
+        {
+            m_free = index_type(entry(x).hash);
+            return x;
+        }
+
+        if (m_used == entries_capacity())
+            add_block();
+        x = m_used++;
+        entry(x).bucket = npos;
+        return x;
+    }
+
+    void release_entry(index_type x)
+    {
+        slot& s = entry(x);
+        s.bucket = npos;
+        s.hash = m_free;
+        m_free = x;
+    }
+
+    void destroy_all()
+    {
+        if (!std::is_trivially_destructible<value_type>::value)
+        {
+            for(index_type x = 0; x < m_used; ++x)
+                if (entry(x).bucket != npos)
+                    entry(x).value().~value_type();
+        }
+    }
+
+    // index
+
+    void set_ctrl(size_type i, ctrl_type c)
+    {
+        m_ctrl[i] = c;
+        // the first group is mirrored past the end for unaligned group loads
+        if (i < group_type::width - 1)
+            m_ctrl[bucket_count() + i] = c;
+    }
+
+    void reset_ctrl()
+    {
+        std::fill(m_ctrl.begin(), m_ctrl.end(), details::flat::ctrl_empty);
+        m_growth_left = max_load(bucket_count()) - m_size;
+    }
+
+    template <class TOther>
+    index_type find_entry(const TOther& key, std::size_t hash) const
+    {
+        if (m_index.empty())
+            return m_used;
+
+        size_type pos = probe_start(hash);
+        for(size_type step = group_type::width; ; step += group_type::width)
+        {
+            group_type g(&m_ctrl[pos]);
+            for(auto match = g.match(h2(hash)); match.any(); match.clear_lowest())
+            {
+                const index_type x = m_index[(pos + match.lowest()) & m_mask];
+                const slot& s = entry(x);
+                if (s.hash == hash && m_equal(s.value().first, key))
+                    return x;
+            }
+            if (g.match_empty().any())
+                return m_used;
+            pos = (pos + step) & m_mask;
+        }
+    }
+
+    size_type find_free_bucket(std::size_t hash) const
+    {
+        size_type pos = probe_start(hash);
+        for(size_type step = group_type::width; ; step += group_type::width)
+        {
+            auto match = group_type(&m_ctrl[pos]).match_empty_or_deleted();
+            if (match.any())
+                return (pos + match.lowest()) & m_mask;
+            pos = (pos + step) & m_mask;
+        }
+    }
+
+    void insert_index(index_type x, std::size_t hash)
+    {
+        size_type bucket = find_free_bucket(hash);
+        if (m_growth_left == 0 && m_ctrl[bucket] != details::flat::ctrl_deleted)
+        {
+            // out of empty buckets: drop tombstones or grow
+            rehash(m_size + 1 <= max_load(bucket_count()) / 2 ? bucket_count() : bucket_count() * 2);
+            bucket = find_free_bucket(hash);
+        }
+
+        if (m_ctrl[bucket] == details::flat::ctrl_empty)
+            --m_growth_left;
+        set_ctrl(bucket, h2(hash));
+        m_index[bucket] = x;
+        entry(x).bucket = index_type(bucket);
+    }
+
+    void erase_index(size_type bucket)
+    {
+        // bucket can become empty again if no probe sequence ever passed
+        // over it as a full group
+        const size_type before = (bucket - group_type::width) & m_mask;
+        const auto empty_after = group_type(&m_ctrl[bucket]).match_empty();
+        const auto empty_before = group_type(&m_ctrl[before]).match_empty();
+        const bool was_never_full = empty_before.any() && empty_after.any() &&
+            empty_after.trailing_zeros() + empty_before.leading_zeros() < group_type::width;
+
+        set_ctrl(bucket, was_never_full ? details::flat::ctrl_empty : details::flat::ctrl_deleted);
+        if (was_never_full)
+            ++m_growth_left;
+    }
+
+    // rebuilds the index only, entries stay in place
+    void rehash(size_type buckets)
+    {
+        limo_assert(max_load(buckets) >= m_size, "rehash would lose elements");
+
+        if (buckets != bucket_count())
+        {
+            m_index.assign(buckets, index_type(npos));
+            m_mask = buckets - 1;
+        }
+        m_ctrl.assign(buckets + group_type::width - 1, details::flat::ctrl_empty);
+        m_growth_left = max_load(buckets);
+
+        for(index_type x = 0; x < m_used; ++x)
+        {
+            slot& s = entry(x);
+            if (s.bucket == npos)
+                continue;
+            const size_type bucket = find_free_bucket(s.hash);
+            --m_growth_left;
+            set_ctrl(bucket, h2(s.hash));
+            m_index[bucket] = x;
+            s.bucket = index_type(bucket);
+        }
+    }
+
+private:
+    std::vector<ctrl_type>      m_ctrl;
+    std::vector<index_type>     m_index;
+    size_type                   m_mask;
+    size_type                   m_growth_left;
+    size_type                   m_size;
+
+    std::vector<std::unique_ptr<slot[]> > m_blocks;
+    unsigned                    m_block_shift;
+    index_type                  m_used;
+    index_type                  m_free;
+
+    hasher                      m_hash;
+    key_equal                   m_equal;
+};
+
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
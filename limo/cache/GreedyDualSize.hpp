@@ -0,0 +1,277 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/assert.hpp>
+
+// include std:
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+// GreedyDual-Size: every entry gets the credit cost/weight on insertion
+// and on each hit, on top of the inflation value L. The entry with the
+// least credit is evicted and its credit becomes the new L, so entries 
+// that are cheap to recompute or heavy go first and untouched entries age.
+// Uses the push(key, cost) form of the contract: Cache passes the weight 
+// and the time the computation took; promote(x, cost) takes the new ones
+// of a value replaced by insert(). Entries live in a slot array indexed
+// by an intrusive binary min-heap, hits and misses do not allocate once
+// the cache is full.
+template <typename TKey>
+class GreedyDualSize 
+{
+public:
+    typedef GreedyDualSize<TKey>    self_type;
+    typedef std::uint32_t           index_type;
+    typedef std::size_t             size_type;
+
+public: // contract types
+    typedef index_type  order_info;
+    typedef TKey        key_type;
+    
+public: // ctors
+
+    explicit GreedyDualSize(size_type capacity = 0)
+    : m_slots()
+    , m_heap()
+    , m_free()
+    , m_inflation(0)
+    {
+        m_slots.reserve(capacity);
+        m_heap.reserve(capacity);
+    }
+
+    // slots point into the owning cache, copy would leave them dangling
+    GreedyDualSize(const self_type&) = delete;
+    self_type& operator=(const self_type&) = delete;
+    GreedyDualSize(self_type&&) = default;
+    self_type& operator=(self_type&&) = default;
+
+    void swap(self_type& other)
+    {
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_heap, other.m_heap);
+        std::swap(m_free, other.m_free);
+        std::swap(m_inflation, other.m_inflation);
+    }
+
+    double inflation() const { return m_inflation; }
+
+public: // CacheStrategy contract interface
+
+    void clear()
+    {
+        m_slots.clear();
+        m_heap.clear();
+        m_free.clear();
+        m_inflation = 0;
+    }
+
+    order_info promote(order_info x) 
+    {
+        // L never decreases, so the priority can only grow
+        slot& s = m_slots[x];
+        s.priority = m_inflation + s.credit;
+        sift_down(s.position);
+        return x;
+    }
+
+    // the credit follows the new cost, so the priority may also drop
+    template <class TCost>
+    order_info promote(order_info x, const TCost& cost) 
+    {
+        slot& s = m_slots[x];
+        s.credit = cost.cost / std::max<size_type>(cost.weight, 1);
+        s.priority = m_inflation + s.credit;
+        sift_up(s.position);
+        sift_down(s.position);
+        return x;
+    }
+
+    order_info push(const key_type& key) 
+    {
+        return push(key, 1.0, 1);
+    }
+
+    template <class TCost>
+    order_info push(const key_type& key, const TCost& cost) 
+    {
+        return push(key, cost.cost, cost.weight);
+    }
+    
+    const key_type& pop() 
+    {
+        limo_contract(!m_heap.empty(), "push/pop call balance broken");
+
+        const index_type x = m_heap.front();
+        m_inflation = m_slots[x].priority;
+
+        place(0, m_heap.back());
+        m_heap.pop_back();
+        if (!m_heap.empty())
+            sift_down(0);
+
+        m_free.push_back(x);
+        return *m_slots[x].key;
+    }
+
+    void erase(order_info x) 
+    {
+        const index_type position = m_slots[x].position;
+        place(position, m_heap.back());
+        m_heap.pop_back();
+        if (position < m_heap.size())
+        {
+            sift_up(position);
+            sift_down(position);
+        }
+        m_free.push_back(x);
+    }
+
+    // least priority first
+    template <class TFunction>
+    void for_each(TFunction f) const
+    {
+        std::vector<index_type> order(m_heap);
+        std::sort(order.begin(), order.end(), [this](index_type a, index_type b) {
+            return m_slots[a].priority < m_slots[b].priority;
+        });
+        for(index_type x : order)
+            f(*m_slots[x].key);
+    }
+
+private: // internals
+
+    struct slot
+    {
+        const key_type* key;
+        double          credit;     // cost / weight
+        double          priority;   // inflation at the last touch + credit
+        index_type      position;   // in the heap
+    };
+
+    order_info push(const key_type& key, double cost, size_type weight) 
+    {
+        index_type x;
+        if (!m_free.empty())
+        {
+            x = m_free.back();
+            m_free.pop_back();
+        }
+        else
+        {
+            limo_assert(m_slots.size() < index_type(-1), "too many slots");
+            x = index_type(m_slots.size());
+            m_slots.emplace_back();
+        }
+
+        slot& s = m_slots[x];
+        s.key = &key;
+        s.credit = cost / std::max<size_type>(weight, 1);
+        s.priority = m_inflation + s.credit;
+
+        m_heap.push_back(x);
+        s.position = index_type(m_heap.size() - 1);
+        sift_up(s.position);
+        return x;
+    }
+
+    void place(index_type position, index_type x)
+    {
+        m_heap[position] = x;
+        m_slots[x].position = position;
+    }
+
+    bool less(index_type a, index_type b) const
+    {
+        return m_slots[m_heap[a]].priority < m_slots[m_heap[b]].priority;
+    }
+
+    void sift_up(index_type i)
+    {
+        const index_type x = m_heap[i];
+        while (i > 0)
+        {
+            const index_type parent = (i - 1) / 2;
+            if (!(m_slots[x].priority < m_slots[m_heap[parent]].priority))
+                break;
+            place(i, m_heap[parent]);
+            i = parent;
+        }
+        place(i, x);
+    }
+
+    void sift_down(index_type i)
+    {
+        const index_type x = m_heap[i];
+        const index_type n = index_type(m_heap.size());
+        for(;;)
+        {
+            index_type child = 2 * i + 1;
+            if (child >= n)
+                break;
+            if (child + 1 < n && less(child + 1, child))
+                ++child;
+            if (!(m_slots[m_heap[child]].priority < m_slots[x].priority))
+                break;
+            place(i, m_heap[child]);
+            i = child;
+        }
+        place(i, x);
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, const self_type& order) 
+    {
+        o << "L=" << order.m_inflation << " [";
+        for(index_type x : order.m_heap) 
+            o << *order.m_slots[x].key << ":" << order.m_slots[x].priority << ", ";
+        return o << "]";
+    }
+
+private:
+    std::vector<slot>       m_slots;
+    std::vector<index_type> m_heap;
+    std::vector<index_type> m_free;
+    double                  m_inflation;
+};
+   
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,201 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/assert.hpp>
+
+// include std:
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+// LRU with the recency links kept in an index-linked slot array.
+// Slots reference the keys owned by the cache (cache map nodes are stable),
+// so no key is duplicated and promote() is a splice of two indices: hits do
+// not allocate. Slots are recycled through a free list, so once the cache is
+// full the strategy does not allocate on misses either.
+template <typename TKey>
+class IntrusiveLRU 
+{
+public:
+    typedef IntrusiveLRU<TKey>  self_type;
+    typedef std::uint32_t       index_type;
+    typedef std::size_t         size_type;
+
+public: // contract types
+    typedef index_type  order_info;
+    typedef TKey        key_type;
+    
+public: // ctors
+
+    explicit IntrusiveLRU(size_type capacity = 0)
+    : m_slots(1)
+    , m_free(nil)
+    {
+        m_slots.reserve(capacity + 1);
+        reset_sentinel();
+    }
+
+    // slots point into the owning cache, copy would leave them dangling
+    IntrusiveLRU(const self_type&) = delete;
+    self_type& operator=(const self_type&) = delete;
+    IntrusiveLRU(self_type&&) = default;
+    self_type& operator=(self_type&&) = default;
+
+    void swap(self_type& other)
+    {
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_free, other.m_free);
+    }
+
+public: // CacheStrategy contract interface
+
+    void clear()
+    {
+        m_slots.resize(1);  // keeps capacity
+        m_free = nil;
+        reset_sentinel();
+    }
+
+    order_info promote(order_info x) 
+    {
+        unlink(x);
+        link_front(x);
+        return x;
+    }
+
+    order_info push(const key_type& key) 
+    {
+        index_type x = m_free;
+        if (x != nil)
+        {
+            m_free = m_slots[x].next;
+        }
+        else
+        {
+            limo_assert(m_slots.size() < index_type(-1), "too many slots");
+            x = index_type(m_slots.size());
+            m_slots.emplace_back();
+        }
+
+        m_slots[x].key = &key;
+        link_front(x);
+        return x;
+    }
+    
+    const key_type& pop() 
+    {
+        const index_type x = m_slots[nil].prev;
+        limo_contract(x != nil, "push/pop call balance broken");
+
+        unlink(x);
+        release(x);
+        return *m_slots[x].key;
+    }
+
+    void erase(order_info x) 
+    {
+        unlink(x);
+        release(x);
+    }
+
+    // next victim first
+    template <class TFunction>
+    void for_each(TFunction f) const
+    {
+        for(index_type x = m_slots[nil].prev; x != nil; x = m_slots[x].prev)
+            f(*m_slots[x].key);
+    }
+
+private: // internals
+
+    // slot 0 is the sentinel of the circular list: next is MRU, prev is LRU
+    static const index_type nil = 0;
+
+    struct slot
+    {
+        const key_type* key;
+        index_type      prev;
+        index_type      next;
+
+        slot(): key(nullptr), prev(nil), next(nil) {}
+    };
+
+    void reset_sentinel()
+    {
+        m_slots[nil].prev = nil;
+        m_slots[nil].next = nil;
+    }
+
+    void unlink(index_type x)
+    {
+        slot& s = m_slots[x];
+        m_slots[s.prev].next = s.next;
+        m_slots[s.next].prev = s.prev;
+    }
+
+    void release(index_type x)
+    {
+        m_slots[x].next = m_free;
+        m_free = x;
+    }
+
+    void link_front(index_type x)
+    {
+        slot& s = m_slots[x];
+        s.prev = nil;
+        s.next = m_slots[nil].next;
+        m_slots[s.next].prev = x;
+        m_slots[nil].next = x;
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, const self_type& order) 
+    {
+        o << "[";
+        for(index_type x = order.m_slots[nil].next; x != nil; x = order.m_slots[x].next) 
+            o << *order.m_slots[x].key << ", ";
+        return o << "]";
+    }
+
+private:
+    std::vector<slot>   m_slots;
+    index_type          m_free;
+};
+   
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
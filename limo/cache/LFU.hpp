@@ -0,0 +1,171 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/assert.hpp>
+
+// include std:
+#include <list>
+#include <ostream>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+// Least frequently used with O(1) promote/push/pop: a list of frequency 
+// buckets in increasing order, each one holding its keys in recency order.
+// Ties are broken by LRU within the least frequent bucket.
+template <typename TKey>
+class LFU 
+{
+public:
+    typedef LFU<TKey>               self_type;
+    typedef std::size_t             size_type;
+    typedef std::list<TKey>         keys_type;
+
+    struct bucket_type
+    {
+        size_type   frequency;
+        keys_type   keys;
+
+        explicit bucket_type(size_type f): frequency(f), keys() {}
+    };
+
+    typedef std::list<bucket_type>  buckets_type;
+
+public: // contract types
+    typedef TKey key_type;
+
+    struct order_info 
+    {
+        typename buckets_type::iterator bucket;
+        typename keys_type::iterator    order;
+    };
+    
+public: // ctors
+
+    LFU() = default;
+
+    // order_info refers into this instance, copies would share them
+    LFU(const self_type&) = delete;
+    self_type& operator=(const self_type&) = delete;
+    LFU(self_type&&) = default;
+    self_type& operator=(self_type&&) = default;
+
+    void swap(self_type& other)
+    {
+        std::swap(m_buckets, other.m_buckets);
+    }
+
+public: // CacheStrategy contract interface
+
+    void clear()
+    {
+        m_buckets.clear();
+    }
+
+    order_info promote(order_info x) 
+    {
+        auto next = x.bucket;
+        ++next;
+        if (next == m_buckets.end() || next->frequency != x.bucket->frequency + 1)
+            next = m_buckets.insert(next, bucket_type(x.bucket->frequency + 1));
+
+        // splice: the key node is moved, not copied
+        next->keys.splice(next->keys.begin(), x.bucket->keys, x.order);
+        if (x.bucket->keys.empty())
+            m_buckets.erase(x.bucket);
+
+        return order_info{next, next->keys.begin()};
+    }
+
+    order_info push(const key_type& key) 
+    {
+        if (m_buckets.empty() || m_buckets.front().frequency != 1)
+            m_buckets.emplace_front(1);
+
+        auto first = m_buckets.begin();
+        first->keys.push_front(key);
+        return order_info{first, first->keys.begin()};
+    }
+    
+    key_type pop() 
+    {
+        limo_contract(!m_buckets.empty(), "push/pop call balance broken");
+
+        auto least = m_buckets.begin();
+        key_type key = least->keys.back();
+        least->keys.pop_back();
+        if (least->keys.empty())
+            m_buckets.erase(least);
+        return key;
+    }
+
+    void erase(order_info x) 
+    {
+        x.bucket->keys.erase(x.order);
+        if (x.bucket->keys.empty())
+            m_buckets.erase(x.bucket);
+    }
+
+    // next victim first
+    template <class TFunction>
+    void for_each(TFunction f) const
+    {
+        for(const auto& b : m_buckets)
+            for(auto x = b.keys.rbegin(); x != b.keys.rend(); ++x)
+                f(*x);
+    }
+
+private: // internals
+
+    friend std::ostream& operator<<(std::ostream& o, const self_type& order) 
+    {
+        o << "[";
+        for(const auto& b : order.m_buckets) 
+        {
+            o << b.frequency << ": (";
+            for(const auto& x : b.keys) 
+                o << x << ", ";
+            o << "), ";
+        }
+        return o << "]";
+    }
+
+private:
+    buckets_type m_buckets;
+};
+   
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
@@ -27,9 +27,11 @@ SOFTWARE.
 //------------------------------------------------------------------------------
 
 // include local:
+#include <limo/assert.hpp>
 
 // include std:
 #include <list>
+#include <ostream>
 
 // forward declarations:
 
@@ -88,6 +90,19 @@ public: // CacheStrategy contract interface
         return key;
     }
 
+    void erase(order_info x) 
+    {
+        m_order.erase(x);
+    }
+
+    // next victim first
+    template <class TFunction>
+    void for_each(TFunction f) const
+    {
+        for(auto x = m_order.rbegin(); x != m_order.rend(); ++x)
+            f(*x);
+    }
+
 private: // internals
 
     friend std::ostream& operator<<(std::ostream& o, const self_type& order) 
@@ -0,0 +1,211 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+
+// include std:
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(_WIN32)
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+// Encoding of keys and values in cache snapshots (Cache::save/load).
+// Trivially copyable types are stored as their bytes, std::string as its
+// length and characters; specialize for other types:
+//  static void write(std::ostream&, const T&)
+//  static bool read(const char*& cursor, const char* end, T&)
+template <class T, class = void>
+struct snapshot_traits;
+
+template <class T>
+struct snapshot_traits<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+{
+    static void write(std::ostream& o, const T& x)
+    {
+        o.write(reinterpret_cast<const char*>(&x), sizeof(T));
+    }
+
+    static bool read(const char*& cursor, const char* end, T& x)
+    {
+        if (std::size_t(end - cursor) < sizeof(T))
+            return false;
+        std::memcpy(&x, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return true;
+    }
+};
+
+template <>
+struct snapshot_traits<std::string>
+{
+    static void write(std::ostream& o, const std::string& x)
+    {
+        snapshot_traits<std::uint64_t>::write(o, x.size());
+        o.write(x.data(), x.size());
+    }
+
+    static bool read(const char*& cursor, const char* end, std::string& x)
+    {
+        std::uint64_t size = 0;
+        if (!snapshot_traits<std::uint64_t>::read(cursor, end, size) || 
+            std::uint64_t(end - cursor) < size)
+            return false;
+        x.assign(cursor, std::size_t(size));
+        cursor += size;
+        return true;
+    }
+};
+
+namespace details
+{
+    // precedes the entries of a snapshot; sizes tell a snapshot of other
+    // types apart (0 for types that are not trivially copyable)
+    struct snapshot_header
+    {
+        char            magic[8];
+        std::uint32_t   version;
+        std::uint32_t   key_size;
+        std::uint32_t   value_size;
+        std::uint32_t   reserved;
+        std::uint64_t   count;
+
+        template <class TKey, class TValue>
+        static snapshot_header make(std::uint64_t count)
+        {
+            snapshot_header x = {{'l', 'i', 'm', 'o', 'c', 'a', 'c', 'h'}, 1, 
+                type_size<TKey>(), type_size<TValue>(), 0, count};
+            return x;
+        }
+
+        template <class TKey, class TValue>
+        bool matches() const
+        {
+            const snapshot_header x = make<TKey, TValue>(0);
+            return std::memcmp(magic, x.magic, sizeof(magic)) == 0 
+                && version == x.version
+                && key_size == x.key_size 
+                && value_size == x.value_size;
+        }
+
+        template <class T>
+        static std::uint32_t type_size()
+        {
+            return std::is_trivially_copyable<T>::value ? std::uint32_t(sizeof(T)) : 0;
+        }
+    };
+
+    // read-only view of a whole file: mapped where mmap is available, 
+    // so the pages are read on demand by the kernel, read into memory
+    // elsewhere
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string& path)
+        : m_data(nullptr)
+        , m_size(0)
+        {
+#if defined(_WIN32)
+            std::ifstream in(path, std::ios::binary | std::ios::ate);
+            if (!in)
+                return;
+            m_buffer.resize(std::size_t(in.tellg()));
+            in.seekg(0);
+            if (in.read(m_buffer.data(), m_buffer.size()))
+            {
+                m_data = m_buffer.data();
+                m_size = m_buffer.size();
+            }
+#else
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+
+            struct stat info;
+            if (::fstat(fd, &info) == 0 && info.st_size > 0)
+            {
+                void* data = ::mmap(nullptr, std::size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED)
+                {
+                    ::madvise(data, std::size_t(info.st_size), MADV_SEQUENTIAL);
+                    m_data = static_cast<const char*>(data);
+                    m_size = std::size_t(info.st_size);
+                }
+            }
+            ::close(fd);
+#endif
+        }
+
+        ~MappedFile()
+        {
+#if !defined(_WIN32)
+            if (m_data)
+                ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        explicit operator bool() const { return m_data != nullptr; }
+
+        const char* begin() const { return m_data; }
+        const char* end()   const { return m_data + m_size; }
+
+    private:
+        const char*         m_data;
+        std::size_t         m_size;
+#if defined(_WIN32)
+        std::vector<char>   m_buffer;
+#endif
+    };
+
+} // namespace details
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
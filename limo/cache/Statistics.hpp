@@ -0,0 +1,324 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+
+// include std:
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+// Snapshot of the counters of a cache, plain values. Counts are since the
+// creation or the last clear() of the cache; the difference of two 
+// snapshots gives the counts and rates of the interval between them.
+struct CacheStatistics
+{
+    typedef std::size_t size_type;
+
+    // bucket i counts loads that took less than 2^i ns (and not less 
+    // than 2^(i-1) ns)
+    static const size_type latency_buckets = 40;
+    typedef std::array<size_type, latency_buckets> latency_type;
+
+    size_type       hits;
+    size_type       misses;     // expired entries included
+    size_type       expired;
+    size_type       evictions;
+    size_type       inserts;    // new entries, replacements not counted
+    size_type       loads;      // values computed for the cache
+    double          load_time;  // seconds, all loads
+    size_type       weight;     // current, see Cache::set_weigher
+    double          uptime;     // seconds
+    latency_type    load_latency;
+
+    size_type size() const { return inserts - evictions - expired; }
+
+    double hit_ratio() const 
+    { 
+        return ratio(double(hits), double(hits + misses)); 
+    }
+
+    double average_load_time()  const { return ratio(load_time, double(loads)); }
+    double insert_rate()        const { return ratio(double(inserts), uptime); }
+    double evict_rate()         const { return ratio(double(evictions), uptime); }
+
+    // upper bound of the load latency for the given share of loads, seconds
+    double load_latency_percentile(double share) const
+    {
+        const double wanted = share * double(loads);
+        double seen = 0;
+        for(size_type i = 0; i < latency_buckets; ++i)
+        {
+            seen += double(load_latency[i]);
+            if (load_latency[i] && seen >= wanted)
+                return double(std::uint64_t(1) << i) * 1e-9;
+        }
+        return loads ? double(std::uint64_t(1) << (latency_buckets - 1)) * 1e-9 : 0;
+    }
+
+    // merge: the counts of several caches (shards) together
+    CacheStatistics& operator+=(const CacheStatistics& other)
+    {
+        hits        += other.hits;
+        misses      += other.misses;
+        expired     += other.expired;
+        evictions   += other.evictions;
+        inserts     += other.inserts;
+        loads       += other.loads;
+        load_time   += other.load_time;
+        weight      += other.weight;
+        uptime      = std::max(uptime, other.uptime);
+        for(size_type i = 0; i < latency_buckets; ++i)
+            load_latency[i] += other.load_latency[i];
+        return *this;
+    }
+
+    // interval between an earlier snapshot and this one, weight stays current
+    CacheStatistics since(const CacheStatistics& earlier) const
+    {
+        CacheStatistics result = *this;
+        result.hits        -= earlier.hits;
+        result.misses      -= earlier.misses;
+        result.expired     -= earlier.expired;
+        result.evictions   -= earlier.evictions;
+        result.inserts     -= earlier.inserts;
+        result.loads       -= earlier.loads;
+        result.load_time   -= earlier.load_time;
+        result.uptime      -= earlier.uptime;
+        for(size_type i = 0; i < latency_buckets; ++i)
+            result.load_latency[i] -= earlier.load_latency[i];
+        return result;
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, const CacheStatistics& x) 
+    {
+        return o 
+            << "hits=" << x.hits << ", misses=" << x.misses 
+            << ", hit_ratio=" << x.hit_ratio()
+            << ", expired=" << x.expired << ", evictions=" << x.evictions 
+            << ", inserts=" << x.inserts << ", weight=" << x.weight
+            << ", loads=" << x.loads << ", load_avg=" << x.average_load_time() 
+            << "s, load_p99<" << x.load_latency_percentile(0.99) << "s"
+            << ", insert_rate=" << x.insert_rate() << "/s"
+            << ", evict_rate=" << x.evict_rate() << "/s";
+    }
+
+private:
+    static double ratio(double a, double b) { return b > 0 ? a / b : 0; }
+};
+
+namespace details
+{
+    // counter with a single writer at a time (the owner of the cache or
+    // the holder of its lock), readable from any thread: a relaxed load 
+    // and store, no locked read-modify-write on the hot path
+    class RelaxedCounter
+    {
+    public:
+        typedef std::uint64_t value_type;
+
+        RelaxedCounter(): m_value(0) {}
+        RelaxedCounter(const RelaxedCounter& other): m_value(other.get()) {}
+
+        RelaxedCounter& operator=(const RelaxedCounter& other)
+        {
+            set(other.get());
+            return *this;
+        }
+
+        value_type get() const { return m_value.load(std::memory_order_relaxed); }
+        void set(value_type x) { m_value.store(x, std::memory_order_relaxed); }
+
+        void add(value_type x = 1) { set(get() + x); }
+        void sub(value_type x = 1) { set(get() - x); }
+
+    private:
+        std::atomic<value_type> m_value;
+    };
+
+    // counter for many concurrent writers: each thread adds to one of 
+    // several stripes a cache line apart, so writers do not bounce the 
+    // same line; reads sum the stripes
+    class StripedCounter
+    {
+    public:
+        typedef std::uint64_t value_type;
+
+        StripedCounter(): m_stripes() { clear(); }
+
+        StripedCounter(const StripedCounter&) = delete;
+        StripedCounter& operator=(const StripedCounter&) = delete;
+
+        void add(value_type x = 1) 
+        { 
+            m_stripes[thread_stripe()].value.fetch_add(x, std::memory_order_relaxed); 
+        }
+
+        value_type get() const
+        {
+            value_type result = 0;
+            for(const auto& x : m_stripes)
+                result += x.value.load(std::memory_order_relaxed);
+            return result;
+        }
+
+        void clear()
+        {
+            for(auto& x : m_stripes)
+                x.value.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        static const std::size_t stripes = 16;
+
+        struct stripe
+        {
+            std::atomic<value_type> value;
+            char                    padding[64 - sizeof(std::atomic<value_type>)];
+        };
+
+        static std::size_t thread_stripe()
+        {
+            static std::atomic<std::size_t> next(0);
+            static thread_local const std::size_t mine = 
+                next.fetch_add(1, std::memory_order_relaxed) % stripes;
+            return mine;
+        }
+
+        std::array<stripe, stripes> m_stripes;
+    };
+
+    // live counters behind CacheStatistics
+    class CacheCounters
+    {
+    public:
+        typedef std::chrono::steady_clock clock_type;
+
+        CacheCounters()
+        : hits(), misses(), expired(), evictions(), inserts(), loads(), weight()
+        , m_load_time(), m_latency(), m_start(now())
+        {
+        }
+
+        RelaxedCounter  hits;
+        RelaxedCounter  misses;
+        RelaxedCounter  expired;
+        RelaxedCounter  evictions;
+        RelaxedCounter  inserts;
+        RelaxedCounter  loads;
+        RelaxedCounter  weight;
+
+        void record_load(double seconds)
+        {
+            const std::uint64_t ns = seconds > 0 ? std::uint64_t(seconds * 1e9) : 0;
+            std::size_t bucket = 0;
+            while(bucket + 1 < CacheStatistics::latency_buckets && (ns >> bucket) != 0)
+                ++bucket;
+
+            loads.add();
+            m_load_time.add(ns);
+            m_latency[bucket].add();
+        }
+
+        // weight is state, not a count: it is kept
+        void clear()
+        {
+            const RelaxedCounter::value_type current = weight.get();
+            *this = CacheCounters();
+            weight.set(current);
+        }
+
+        CacheStatistics snapshot() const
+        {
+            CacheStatistics x;
+            x.hits      = hits.get();
+            x.misses    = misses.get();
+            x.expired   = expired.get();
+            x.evictions = evictions.get();
+            x.inserts   = inserts.get();
+            x.loads     = loads.get();
+            x.load_time = double(m_load_time.get()) * 1e-9;
+            x.weight    = weight.get();
+            x.uptime    = double(now() - m_start.load(std::memory_order_relaxed)) * 1e-9;
+            for(std::size_t i = 0; i < CacheStatistics::latency_buckets; ++i)
+                x.load_latency[i] = m_latency[i].get();
+            return x;
+        }
+
+        CacheCounters(const CacheCounters& other)
+        : hits(other.hits), misses(other.misses), expired(other.expired)
+        , evictions(other.evictions), inserts(other.inserts), loads(other.loads)
+        , weight(other.weight), m_load_time(other.m_load_time), m_latency(other.m_latency)
+        , m_start(other.m_start.load(std::memory_order_relaxed))
+        {
+        }
+
+        CacheCounters& operator=(const CacheCounters& other)
+        {
+            hits        = other.hits;
+            misses      = other.misses;
+            expired     = other.expired;
+            evictions   = other.evictions;
+            inserts     = other.inserts;
+            loads       = other.loads;
+            weight      = other.weight;
+            m_load_time = other.m_load_time;
+            m_latency   = other.m_latency;
+            m_start.store(other.m_start.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            return *this;
+        }
+
+    private:
+        static std::int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                clock_type::now().time_since_epoch()).count();
+        }
+
+        RelaxedCounter  m_load_time;    // ns
+        std::array<RelaxedCounter, CacheStatistics::latency_buckets> m_latency;
+        std::atomic<std::int64_t> m_start;
+    };
+
+} // namespace details
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,104 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/cache/FlatHashMap.hpp>
+#include <limo/cache/TransparentHash.hpp>
+
+// include std:
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+// Storage policies for Cache: map_type is the key -> cache line container, 
+// reserve() is called whenever the cache gets its first entry, with the 
+// expected number of entries (the capacity without a weigher, see 
+// Cache::set_weigher); it must not shrink the map. prefetch() is a hint
+// that the key will be looked up soon, find() looks up by the key type
+// or, with a transparent hash and equality, any type they accept.
+// Containers must keep element addresses stable while elements are alive,
+// strategies may keep pointers to the stored keys.
+
+// node based std::unordered_map, grows on demand
+struct NodeStorage
+{
+    template <typename TKey, typename TMapped, class THash, class TEqual>
+    using map_type = std::unordered_map<TKey, TMapped, THash, TEqual>;
+
+    template <class TMap>
+    static void reserve(TMap&, std::size_t) {}
+
+    template <class TMap, class TKey>
+    static void prefetch(const TMap&, const TKey&) {}
+
+    // no heterogeneous lookup in std::unordered_map before C++20: 
+    // other key types are converted
+    template <class TMap, class TKey>
+    static decltype(auto) find(TMap& map, const TKey& key)
+    {
+        return map.find(details::as_key<typename TMap::key_type>(key));
+    }
+};
+
+// contiguous open addressing table, preallocated to the expected size
+struct FlatStorage
+{
+    template <typename TKey, typename TMapped, class THash, class TEqual>
+    using map_type = FlatHashMap<TKey, TMapped, THash, TEqual>;
+
+    template <class TMap>
+    static void reserve(TMap& map, std::size_t capacity) 
+    {
+        map.reserve(capacity);
+    }
+
+    template <class TMap, class TKey>
+    static void prefetch(const TMap& map, const TKey& key) 
+    {
+        map.prefetch(key);
+    }
+
+    template <class TMap, class TKey>
+    static decltype(auto) find(TMap& map, const TKey& key)
+    {
+        return map.find(key);
+    }
+};
+
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
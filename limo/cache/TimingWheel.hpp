@@ -0,0 +1,348 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/assert.hpp>
+#include <limo/cache/FlatHashMap.hpp>
+
+// include std:
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+// Hierarchical timing wheel (Varghese, Lauck) for entry expiry. Time is cut
+// into ticks of the given resolution; level l has 64 buckets of 64^l ticks
+// each, so 4 levels cover 64^4 ticks (4.6 hours at 1ms), later deadlines
+// wait in the last level and are placed again when it comes round.
+// schedule() and cancel() are O(1); advance() jumps to the next tick that
+// has a bucket to expire or to cascade, found in a bitmap of non-empty 
+// buckets per level, so idle time costs nothing. Cascading moves the 
+// entries of a coarse bucket one level down when the finer level wraps, 
+// each entry is touched at most once per level. Entries are index-linked
+// slots that point to the keys owned by the cache. 
+template <typename TKey, class TClock = std::chrono::steady_clock>
+class TimingWheel 
+{
+public:
+    typedef TimingWheel<TKey, TClock>   self_type;
+    typedef std::uint32_t               index_type;
+    typedef std::uint64_t               tick_type;
+    typedef std::size_t                 size_type;
+
+    typedef TKey                        key_type;
+    typedef TClock                      clock_type;
+    typedef typename clock_type::duration   duration;
+    typedef typename clock_type::time_point time_point;
+
+    static const index_type npos = index_type(-1);
+    
+public: // ctors
+
+    explicit TimingWheel(duration resolution = std::chrono::milliseconds(1))
+    : m_slots(bucket_count)
+    , m_free(npos)
+    , m_size(0)
+    , m_resolution(resolution)
+    , m_origin(clock_type::now())
+    , m_now(0)
+    {
+        limo_contract(resolution.count() > 0, "resolution should be positive");
+        reset_buckets();
+    }
+
+    // slots point into the owning cache, copy would leave them dangling
+    TimingWheel(const self_type&) = delete;
+    self_type& operator=(const self_type&) = delete;
+    TimingWheel(self_type&&) = default;
+    self_type& operator=(self_type&&) = default;
+
+    void swap(self_type& other)
+    {
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_free, other.m_free);
+        std::swap(m_size, other.m_size);
+        std::swap(m_resolution, other.m_resolution);
+        std::swap(m_origin, other.m_origin);
+        std::swap(m_now, other.m_now);
+        std::swap(m_occupied, other.m_occupied);
+    }
+
+public: // state
+
+    bool        empty()     const   { return m_size == 0; }
+    size_type   size()      const   { return m_size; }
+    duration    resolution() const  { return m_resolution; }
+
+    time_point deadline(index_type x) const 
+    { 
+        return m_slots[x].deadline; 
+    }
+
+public: // interface
+
+    void clear()
+    {
+        m_slots.resize(bucket_count);  // keeps capacity
+        m_free = npos;
+        m_size = 0;
+        m_origin = clock_type::now();
+        m_now = 0;
+        reset_buckets();
+    }
+
+    // key reference should stay valid until the entry expires or is canceled
+    index_type schedule(const key_type& key, time_point deadline)
+    {
+        index_type x = m_free;
+        if (x != npos)
+        {
+            m_free = m_slots[x].next;
+        }
+        else
+        {
+            limo_assert(m_slots.size() < npos, "too many slots");
+            x = index_type(m_slots.size());
+            m_slots.emplace_back();
+        }
+
+        slot& s = m_slots[x];
+        s.key = &key;
+        s.deadline = deadline;
+        s.tick = tick_of(deadline);
+        place(x);
+        ++m_size;
+        return x;
+    }
+
+    void cancel(index_type x)
+    {
+        unlink(x);
+        release(x);
+    }
+
+    // calls expired(key) for every entry with deadline up to now, the 
+    // entry is already removed from the wheel at that moment
+    template <class TFunction>
+    void advance(time_point now, TFunction expired)
+    {
+        if (now < m_origin)
+            return;
+
+        const tick_type target = tick_type((now - m_origin) / m_resolution);
+        if (empty())
+        {
+            m_now = target + 1;
+            return;
+        }
+
+        for(; !empty(); ++m_now)
+        {
+            // the ticks before have empty buckets only
+            const tick_type next = next_tick();
+            if (next > target)
+                break;
+            m_now = next;
+
+            const tick_type index = m_now & mask;
+            if (index == 0)
+                cascade(1);
+
+            const index_type head = bucket(0, index);
+            while(m_slots[head].next != head)
+            {
+                const index_type x = m_slots[head].next;
+                unlink(x);
+                release(x);
+                expired(*m_slots[x].key);
+            }
+        }
+
+        if (m_now <= target)
+            m_now = target + 1;
+    }
+
+private: // internals
+
+    static const unsigned   level_bits = 6;
+    static const unsigned   levels = 4;
+    static const tick_type  mask = (1u << level_bits) - 1;
+    static const index_type bucket_count = levels << level_bits;
+
+    // buckets are the first slots: sentinels of circular lists
+    struct slot
+    {
+        const key_type* key;
+        time_point      deadline;
+        tick_type       tick;
+        index_type      prev;
+        index_type      next;
+
+        slot(): key(nullptr), deadline(), tick(0), prev(npos), next(npos) {}
+    };
+
+    static index_type bucket(unsigned level, tick_type index)
+    {
+        return index_type((level << level_bits) + index);
+    }
+
+    // first tick from m_now on that processes a non-empty bucket: level 0
+    // expires bucket (tick & mask), level l cascades its bucket at the 
+    // multiples of 64^l
+    tick_type next_tick() const
+    {
+        tick_type result = tick_type(-1);
+        for(unsigned level = 0; level < levels; ++level)
+        {
+            const std::uint64_t occupied = m_occupied[level];
+            if (occupied == 0)
+                continue;
+
+            const unsigned shift = level * level_bits;
+            const tick_type unit = tick_type(1) << shift;
+            const tick_type start = (m_now + unit - 1) & ~(unit - 1);
+            const unsigned index = unsigned(start >> shift) & unsigned(mask);
+            const std::uint64_t rotated = index 
+                ? (occupied >> index) | (occupied << (64 - index)) 
+                : occupied;
+            const tick_type tick = start + 
+                (tick_type(details::flat::count_trailing_zeros(rotated)) << shift);
+            if (tick < result)
+                result = tick;
+        }
+        return result;
+    }
+
+    // first tick not before the deadline: never expires early
+    tick_type tick_of(time_point deadline) const
+    {
+        if (deadline <= m_origin)
+            return 0;
+        const duration offset = deadline - m_origin;
+        return tick_type((offset + m_resolution - duration(1)) / m_resolution);
+    }
+
+    void reset_buckets()
+    {
+        for(index_type i = 0; i < bucket_count; ++i)
+        {
+            m_slots[i].prev = i;
+            m_slots[i].next = i;
+        }
+        for(auto& x : m_occupied)
+            x = 0;
+    }
+
+    void place(index_type x)
+    {
+        // past deadlines go to the bucket processed next
+        tick_type tick = m_slots[x].tick < m_now ? m_now : m_slots[x].tick;
+        const tick_type horizon = tick_type(1) << (levels * level_bits);
+        if (tick - m_now >= horizon)
+            tick = m_now + horizon - 1;
+
+        unsigned level = 0;
+        while(level + 1 < levels && tick - m_now >= (tick_type(1) << ((level + 1) * level_bits)))
+            ++level;
+
+        link(bucket(level, (tick >> (level * level_bits)) & mask), x);
+    }
+
+    // the bucket of the level that covers the coming ticks moves down
+    void cascade(unsigned level)
+    {
+        if (level == levels)
+            return;
+
+        const tick_type index = (m_now >> (level * level_bits)) & mask;
+        if (index == 0)
+            cascade(level + 1);
+
+        const index_type head = bucket(level, index);
+        index_type x = m_slots[head].next;
+        m_slots[head].prev = head;
+        m_slots[head].next = head;
+        m_occupied[level] &= ~(std::uint64_t(1) << index);
+        while(x != head)
+        {
+            const index_type next = m_slots[x].next;
+            place(x);
+            x = next;
+        }
+    }
+
+    void link(index_type head, index_type x)
+    {
+        slot& s = m_slots[x];
+        s.prev = head;
+        s.next = m_slots[head].next;
+        m_slots[s.next].prev = x;
+        m_slots[head].next = x;
+        m_occupied[head >> level_bits] |= std::uint64_t(1) << (head & mask);
+    }
+
+    void unlink(index_type x)
+    {
+        slot& s = m_slots[x];
+        m_slots[s.prev].next = s.next;
+        m_slots[s.next].prev = s.prev;
+
+        // the last entry of a bucket: it links to the bucket both ways
+        if (s.prev == s.next && s.prev < bucket_count)
+            m_occupied[s.prev >> level_bits] &= ~(std::uint64_t(1) << (s.prev & mask));
+    }
+
+    void release(index_type x)
+    {
+        m_slots[x].next = m_free;
+        m_free = x;
+        --m_size;
+    }
+
+private:
+    std::vector<slot>   m_slots;
+    index_type          m_free;
+    size_type           m_size;
+    duration            m_resolution;
+    time_point          m_origin;
+    tick_type           m_now;      // next tick to process
+    std::uint64_t       m_occupied[levels]; // bit per non-empty bucket
+};
+   
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,144 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+
+// include std:
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 201703L
+    #include <string_view>
+#endif
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+    namespace details
+    {
+        // hash and equality both declare is_transparent: lookups may use
+        // any key type they accept, without building the stored key type
+        template <class THash, class TEqual, class = void>
+        struct is_transparent : std::false_type {};
+
+        template <class THash, class TEqual>
+        struct is_transparent<THash, TEqual, decltype(
+            std::declval<typename THash::is_transparent>(), 
+            std::declval<typename TEqual::is_transparent>(), 
+            void())> : std::true_type {};
+
+        // lookup argument as the stored key type: the key itself when it 
+        // is one, a new key otherwise
+        template <class TKey>
+        const TKey& as_key(const TKey& key) 
+        { 
+            return key; 
+        }
+
+        template <class TKey, class TOther, class = typename std::enable_if<
+            !std::is_same<TKey, TOther>::value>::type>
+        TKey as_key(const TOther& key) 
+        { 
+            return TKey(key); 
+        }
+
+        inline std::size_t hash_bytes(const char* data, std::size_t size)
+        {
+            std::uint64_t h = 0x9E3779B97F4A7C15ull ^ size;
+            for(; size >= 8; data += 8, size -= 8)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, data, 8);
+                h = (h ^ word) * 0xFF51AFD7ED558CCDull;
+                h ^= h >> 32;
+            }
+            std::uint64_t tail = 0;
+            std::memcpy(&tail, data, size);
+            h = (h ^ tail) * 0xC4CEB9FE1A85EC53ull;
+            return std::size_t(h ^ (h >> 29));
+        }
+
+        inline std::pair<const char*, std::size_t> chars_of(const std::string& x) 
+        { 
+            return std::make_pair(x.data(), x.size()); 
+        }
+
+        inline std::pair<const char*, std::size_t> chars_of(const char* x) 
+        { 
+            return std::make_pair(x, std::strlen(x)); 
+        }
+
+    #if __cplusplus >= 201703L
+        inline std::pair<const char*, std::size_t> chars_of(std::string_view x) 
+        { 
+            return std::make_pair(x.data(), x.size()); 
+        }
+    #endif
+
+    } // namespace details
+
+
+    // transparent hash and equality for std::string keys: caches and maps
+    // keyed by std::string can be searched with const char* (and 
+    // std::string_view since C++17) without a temporary string
+    struct StringHash
+    {
+        typedef void is_transparent;
+
+        template <class TString>
+        std::size_t operator()(const TString& x) const
+        {
+            const auto chars = details::chars_of(x);
+            return details::hash_bytes(chars.first, chars.second);
+        }
+    };
+
+    struct StringEqual
+    {
+        typedef void is_transparent;
+
+        template <class TLeft, class TRight>
+        bool operator()(const TLeft& x, const TRight& y) const
+        {
+            const auto a = details::chars_of(x);
+            const auto b = details::chars_of(y);
+            return a.second == b.second && std::memcmp(a.first, b.first, a.second) == 0;
+        }
+    };
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,205 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/assert.hpp>
+#include <limo/cache/FlatHashMap.hpp>
+
+// include std:
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <list>
+#include <ostream>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+// 2Q (Johnson, Shasha), full version. New keys enter the A1in FIFO 
+// (a quarter of the capacity) and are not promoted while there. Keys 
+// leaving A1in are remembered in the A1out ghost list (half the capacity);
+// only a miss on a remembered key admits it to the main LRU Am. A scan 
+// cycles through A1in and never reaches Am.
+template <typename TKey>
+class TwoQ 
+{
+public:
+    typedef TwoQ<TKey>      self_type;
+    typedef std::size_t     size_type;
+
+    enum segment_type { a1in, a1out, am };
+
+    struct node_type
+    {
+        TKey            key;
+        segment_type    segment;
+    };
+
+    typedef std::list<node_type>    order_type;
+
+public: // contract types
+    typedef typename order_type::iterator   order_info;
+    typedef TKey                            key_type;
+
+public: // ctors
+
+    explicit TwoQ(size_type capacity)
+    : m_in_max(std::max<size_type>(1, capacity / 4))
+    , m_out_max(std::max<size_type>(1, capacity / 2))
+    , m_ghosts(m_out_max)
+    {
+    }
+
+    // order_info refers into this instance, copies would share them
+    TwoQ(const self_type&) = delete;
+    self_type& operator=(const self_type&) = delete;
+    TwoQ(self_type&&) = default;
+    self_type& operator=(self_type&&) = default;
+
+    void swap(self_type& other)
+    {
+        std::swap(m_in_max, other.m_in_max);
+        std::swap(m_out_max, other.m_out_max);
+        std::swap(m_lists, other.m_lists);
+        m_ghosts.swap(other.m_ghosts);
+    }
+
+public: // CacheStrategy contract interface
+
+    void clear()
+    {
+        for(auto& x : m_lists)
+            x.clear();
+        m_ghosts.clear();
+    }
+
+    order_info promote(order_info x) 
+    {
+        // correlated references in A1in do not count
+        if (x->segment == am)
+            move_front(x, am);
+        return x;
+    }
+
+    order_info push(const key_type& key) 
+    {
+        auto ghost = m_ghosts.find(key);
+        if (ghost != m_ghosts.end())
+        {
+            order_info x = ghost->second;
+            m_ghosts.erase(ghost);
+            move_front(x, am);
+            return x;
+        }
+
+        list(a1in).push_front(node_type{key, a1in});
+        return list(a1in).begin();
+    }
+
+    key_type pop() 
+    {
+        limo_contract(!list(a1in).empty() || !list(am).empty(), "push/pop call balance broken");
+
+        if (list(am).empty() || list(a1in).size() > m_in_max)
+        {
+            // remember it, a second miss will admit it to Am
+            const order_info x = last(a1in);
+            move_front(x, a1out);
+            m_ghosts.insert(std::make_pair(x->key, x));
+            if (list(a1out).size() > m_out_max)
+            {
+                m_ghosts.erase(last(a1out)->key);
+                list(a1out).pop_back();
+            }
+            return x->key;
+        }
+
+        const order_info x = last(am);
+        key_type key = x->key;
+        list(am).erase(x);
+        return key;
+    }
+
+    void erase(order_info x) 
+    {
+        list(x->segment).erase(x);
+    }
+
+    // resident keys: A1in then Am, each from its old end
+    template <class TFunction>
+    void for_each(TFunction f) const
+    {
+        for(segment_type s : {a1in, am})
+            for(auto x = m_lists[s].rbegin(); x != m_lists[s].rend(); ++x)
+                f(x->key);
+    }
+
+private: // internals
+
+    order_type& list(segment_type s) { return m_lists[s]; }
+
+    order_info last(segment_type s) 
+    { 
+        return std::prev(list(s).end()); 
+    }
+
+    void move_front(order_info x, segment_type to)
+    {
+        list(to).splice(list(to).begin(), list(x->segment), x);
+        x->segment = to;
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, const self_type& order) 
+    {
+        const char* names[] = {"A1in", "A1out", "Am"};
+        for(unsigned s = 0; s < 3; ++s)
+        {
+            o << names[s] << ": [";
+            for(const auto& x : order.m_lists[s]) 
+                o << x.key << ", ";
+            o << "] ";
+        }
+        return o;
+    }
+
+private:
+    size_type                           m_in_max;
+    size_type                           m_out_max;
+    order_type                          m_lists[3];
+    FlatHashMap<key_type, order_info>   m_ghosts;
+};
+   
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
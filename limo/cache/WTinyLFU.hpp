@@ -0,0 +1,313 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/assert.hpp>
+#include <limo/cache/FlatHashMap.hpp>
+
+// include std:
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <list>
+#include <ostream>
+#include <vector>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+// Count-min sketch of access frequencies with 4 bit saturating counters.
+// All counters are halved after 10 * capacity increments, so the estimate
+// follows recent popularity rather than the whole history.
+template <typename TKey, class THash = std::hash<TKey> >
+class FrequencySketch
+{
+public:
+    typedef std::size_t size_type;
+    typedef TKey        key_type;
+
+public: // ctors
+
+    explicit FrequencySketch(size_type capacity = 0)
+    : m_counters()
+    , m_mask(0)
+    , m_additions(0)
+    , m_sample_size(0)
+    , m_hash()
+    {
+        size_type width = 16;
+        while(width < capacity)
+            width *= 2;
+        m_counters.assign(depth * width, 0);
+        m_mask = width - 1;
+        m_sample_size = 10 * std::max<size_type>(capacity, 1);
+    }
+
+public: // interface
+
+    void clear()
+    {
+        std::fill(m_counters.begin(), m_counters.end(), 0);
+        m_additions = 0;
+    }
+
+    void increment(const key_type& key)
+    {
+        const std::size_t h = details::flat::mix(m_hash(key));
+        for(unsigned row = 0; row < depth; ++row)
+        {
+            std::uint8_t& counter = m_counters[index(h, row)];
+            if (counter < max_count)
+                ++counter;
+        }
+
+        if (++m_additions == m_sample_size)
+            age();
+    }
+
+    unsigned estimate(const key_type& key) const
+    {
+        const std::size_t h = details::flat::mix(m_hash(key));
+        unsigned result = max_count;
+        for(unsigned row = 0; row < depth; ++row)
+            result = std::min<unsigned>(result, m_counters[index(h, row)]);
+        return result;
+    }
+
+private: // internals
+
+    static const unsigned depth = 4;
+    static const unsigned max_count = 15;
+
+    // double hashing over rows laid out one after another
+    size_type index(std::size_t h, unsigned row) const
+    {
+        const std::size_t step = (h >> (sizeof(std::size_t) * 4)) | 1;
+        return row * (m_mask + 1) + ((h + row * step) & m_mask);
+    }
+
+    void age()
+    {
+        for(auto& x : m_counters)
+            x >>= 1;
+        m_additions /= 2;
+    }
+
+private:
+    std::vector<std::uint8_t>   m_counters;
+    size_type                   m_mask;
+    size_type                   m_additions;
+    size_type                   m_sample_size;
+    THash                       m_hash;
+};
+
+
+// Window TinyLFU: new keys enter a small LRU window (1% of capacity); 
+// keys leaving the window compete for the main segmented LRU (probation
+// and protected, 20/80) against its victim and are admitted only if the 
+// frequency sketch has seen them more often. One-off keys of a scan
+// therefore do not push the frequently used ones out.
+template <typename TKey>
+class WTinyLFU 
+{
+public:
+    typedef WTinyLFU<TKey>  self_type;
+    typedef std::size_t     size_type;
+
+    enum segment_type { window, probation, protected_ };
+
+    struct node_type
+    {
+        TKey            key;
+        segment_type    segment;
+    };
+
+    typedef std::list<node_type>    order_type;
+
+public: // contract types
+    typedef typename order_type::iterator   order_info;
+    typedef TKey                            key_type;
+    
+public: // ctors
+
+    explicit WTinyLFU(size_type capacity)
+    : m_sketch(capacity)
+    , m_window_max(std::max<size_type>(1, capacity / 100))
+    , m_protected_max(0)
+    {
+        const size_type main = capacity > m_window_max ? capacity - m_window_max : 0;
+        m_protected_max = main - main / 5;
+    }
+
+    // order_info refers into this instance, copies would share them
+    WTinyLFU(const self_type&) = delete;
+    self_type& operator=(const self_type&) = delete;
+    WTinyLFU(self_type&&) = default;
+    self_type& operator=(self_type&&) = default;
+
+    void swap(self_type& other)
+    {
+        std::swap(m_sketch, other.m_sketch);
+        std::swap(m_segments, other.m_segments);
+        std::swap(m_window_max, other.m_window_max);
+        std::swap(m_protected_max, other.m_protected_max);
+    }
+
+public: // CacheStrategy contract interface
+
+    void clear()
+    {
+        m_sketch.clear();
+        for(auto& x : m_segments)
+            x.clear();
+    }
+
+    order_info promote(order_info x) 
+    {
+        m_sketch.increment(x->key);
+
+        switch(x->segment)
+        {
+        case window:
+        case protected_:
+            move_front(x, x->segment);
+            break;
+
+        case probation:
+            move_front(x, protected_);
+            if (segment(protected_).size() > m_protected_max)
+                move_front(last(protected_), probation);
+            break;
+        }
+        return x;
+    }
+
+    order_info push(const key_type& key) 
+    {
+        m_sketch.increment(key);
+
+        order_type& w = segment(window);
+        w.push_front(node_type{key, window});
+
+        // there was room in the cache, nothing to compete with
+        if (w.size() > m_window_max)
+            move_front(last(window), probation);
+
+        return w.begin();
+    }
+    
+    key_type pop() 
+    {
+        order_type& w = segment(window);
+        const bool main_empty = segment(probation).empty() && segment(protected_).empty();
+        limo_contract(!w.empty() || !main_empty, "push/pop call balance broken");
+
+        if (w.size() < m_window_max && !main_empty)
+            return erase(main_victim());
+
+        if (main_empty)
+            return erase(last(window));
+
+        // window is full: its LRU key competes with the main victim
+        const order_info candidate = last(window);
+        const order_info victim = main_victim();
+        if (m_sketch.estimate(candidate->key) > m_sketch.estimate(victim->key))
+        {
+            move_front(candidate, probation);
+            return erase(victim);
+        }
+        return erase(candidate);
+    }
+
+    key_type erase(order_info x)
+    {
+        key_type key = x->key;
+        segment(x->segment).erase(x);
+        return key;
+    }
+
+    // probation, window, protected; each from its LRU end
+    template <class TFunction>
+    void for_each(TFunction f) const
+    {
+        for(segment_type s : {probation, window, protected_})
+            for(auto x = m_segments[s].rbegin(); x != m_segments[s].rend(); ++x)
+                f(x->key);
+    }
+
+private: // internals
+
+    order_type& segment(segment_type s) { return m_segments[s]; }
+
+    order_info last(segment_type s) 
+    { 
+        return std::prev(segment(s).end()); 
+    }
+
+    order_info main_victim()
+    {
+        return segment(probation).empty() ? last(protected_) : last(probation);
+    }
+
+    void move_front(order_info x, segment_type to)
+    {
+        segment(to).splice(segment(to).begin(), segment(x->segment), x);
+        x->segment = to;
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, const self_type& order) 
+    {
+        const char* names[] = {"window", "probation", "protected"};
+        for(unsigned s = 0; s < 3; ++s)
+        {
+            o << names[s] << ": [";
+            for(const auto& x : order.m_segments[s]) 
+                o << x.key << ", ";
+            o << "] ";
+        }
+        return o;
+    }
+
+private:
+    FrequencySketch<key_type>   m_sketch;
+    order_type                  m_segments[3];
+    size_type                   m_window_max;
+    size_type                   m_protected_max;
+};
+   
+
+} // namespace limo
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,691 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/cache.hpp>
+#include <limo/bases.hpp>
+
+// include std:
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+namespace details
+{
+    // fixed size thread pool, threads start with the first tasks. The 
+    // destructor runs the queued tasks and joins the threads.
+    class TaskPool : limo::noncopyable
+    {
+    public:
+        explicit TaskPool(std::size_t threads)
+        : m_max_threads(std::max<std::size_t>(1, threads))
+        , m_idle(0)
+        , m_stop(false)
+        {
+        }
+
+        ~TaskPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            for(auto& x : m_threads)
+                x.join();
+        }
+
+        void submit(std::function<void()> task)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(std::move(task));
+            if (m_idle == 0 && m_threads.size() < m_max_threads)
+                m_threads.emplace_back([this]() { run(); });
+            else
+                m_wake.notify_one();
+        }
+
+    private:
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for(;;)
+            {
+                while(m_tasks.empty() && !m_stop)
+                {
+                    ++m_idle;
+                    m_wake.wait(lock);
+                    --m_idle;
+                }
+                if (m_tasks.empty())
+                    return;
+
+                std::function<void()> task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+                lock.unlock();
+                task();
+                lock.lock();
+            }
+        }
+
+        const std::size_t                   m_max_threads;
+        std::size_t                         m_idle;
+        bool                                m_stop;
+        std::mutex                          m_mutex;
+        std::condition_variable             m_wake;
+        std::deque<std::function<void()> >  m_tasks;
+        std::vector<std::thread>            m_threads;
+    };
+
+} // namespace details
+
+
+// Thread safe cache: the key space is split into independently locked 
+// shards, each one is a Cache with its own strategy and statistics.
+// Values are returned by copy, references would outlive the shard lock.
+// With strategies that have a concurrent touch() (see Clock) hits take the
+// shard lock in shared mode only, so readers never wait for each other;
+// misses and evictions take it exclusively.
+// Misses are single-flight: the first thread missing a key computes it 
+// outside of the lock, threads missing the same key meanwhile wait for
+// that result instead of computing it again.
+// get_async() returns a future right away: hits are resolved inline, 
+// misses start the async computor (or the computor on the executor, a 
+// pool of up to a thread per core by default) outside of the shard lock 
+// and stay in flight until the value is ready. Executor tasks report 
+// when they are done, their value enters the cache with the next access
+// of the shard; futures of an async computor are polled, all of them 
+// once their count doubles, and on collect(). A single threaded Cache has
+// no get_async(): without other threads to compute there is nothing to 
+// wait for asynchronously.
+template <
+    typename TKey, 
+    typename TValue, 
+    class TCacheStrategy = LRU<TKey>, 
+    class TStorage = NodeStorage >
+class ConcurrentCache : limo::noncopyable
+{
+public:
+    typedef ConcurrentCache<TKey, TValue, TCacheStrategy, TStorage> self_type;
+    typedef Cache<TKey, TValue, TCacheStrategy, TStorage>           cache_type;
+
+    typedef typename cache_type::size_type          size_type;
+    typedef typename cache_type::key_type           key_type;
+    typedef typename cache_type::cached_type        cached_type;
+    typedef typename cache_type::computor_type      computor_type;
+    typedef typename cache_type::weigher_type       weigher_type;
+    typedef typename cache_type::duration           duration;
+    typedef typename cache_type::strategy_type      strategy_type;
+
+    struct statistics_type : CacheStatistics
+    {
+        size_type coalesced;    // misses served by another thread's computation
+    };
+
+    typedef std::shared_future<cached_type>                     future_type;
+    typedef std::function<future_type(const key_type&)>         async_computor_type;
+    typedef std::function<void(std::function<void()>)>          executor_type;
+
+    // creates the strategy of a shard for the given shard capacity
+    typedef std::function<strategy_type(size_type)> strategy_factory;
+
+    static const bool shared_hit_path = details::has_concurrent_touch<strategy_type>::value;
+
+    // shards argument: default_shards(capacity)
+    static const size_type automatic_shards = 0;
+
+public: // ctors
+    ConcurrentCache(
+        computor_type       computor, 
+        size_type           capacity, 
+        size_type           shards = automatic_shards,
+        strategy_factory    strategy = default_strategy
+    )
+    : ConcurrentCache(computor, pool_executor(std::thread::hardware_concurrency()), 
+        async_computor_type(), capacity, shards, strategy)
+    {
+    }
+
+    // misses of get_async() run the computor on the executor
+    ConcurrentCache(
+        computor_type       computor, 
+        executor_type       executor,
+        size_type           capacity, 
+        size_type           shards = automatic_shards,
+        strategy_factory    strategy = default_strategy
+    )
+    : ConcurrentCache(computor, executor, async_computor_type(), capacity, shards, strategy)
+    {
+    }
+
+    // get() waits for the future of the async computor
+    ConcurrentCache(
+        async_computor_type computor, 
+        size_type           capacity, 
+        size_type           shards = automatic_shards,
+        strategy_factory    strategy = default_strategy
+    )
+    : ConcurrentCache([computor](const key_type& key) { return computor(key).get(); }, 
+        executor_type(), computor, capacity, shards, strategy)
+    {
+    }
+
+    // runs the tasks on up to the given number of threads, started on 
+    // demand; the last copy of the executor waits for the queued tasks
+    static executor_type pool_executor(size_type threads)
+    {
+        auto pool = std::make_shared<details::TaskPool>(threads);
+        return [pool](std::function<void()> task) { pool->submit(std::move(task)); };
+    }
+
+    // runs the task in the calling thread: get_async() then returns once
+    // the value is computed
+    static void inline_executor(std::function<void()> task)
+    {
+        task();
+    }
+
+    static strategy_type default_strategy(size_type)
+    {
+        return strategy_type();
+    }
+
+private:
+    ConcurrentCache(
+        computor_type       computor, 
+        executor_type       executor,
+        async_computor_type async_computor, 
+        size_type           capacity, 
+        size_type           shards,
+        strategy_factory    strategy
+    )
+    : m_shards()
+    , m_mask(0)
+    , m_capacity(capacity)
+    , m_compute(computor)
+    , m_executor(executor)
+    , m_compute_async(async_computor)
+    {
+        if (shards == automatic_shards)
+            shards = default_shards(capacity);
+
+        limo_contract(shards > 0 && (shards & (shards - 1)) == 0, "shards count should be a power of two");
+        limo_contract(capacity >= shards, "at least one entry per shard");
+
+        m_mask = shards - 1;
+        m_shards.reserve(shards);
+        for(size_type i = 0; i < shards; ++i)
+        {
+            // spread the remainder over the first shards
+            const size_type part = capacity / shards + (i < capacity % shards ? 1 : 0);
+            m_shards.emplace_back(new shard_type(computor, part, strategy(part)));
+        }
+    }
+
+public:
+    // 4 shards per hardware thread, rounded up to a power of two, but no
+    // more than the capacity allows, rounded down: each shard holds an entry
+    static size_type default_shards(size_type capacity)
+    {
+        size_type shards = 1;
+        const size_type wanted = 4 * std::max(1u, std::thread::hardware_concurrency());
+        while(shards < wanted)
+            shards *= 2;
+        while(shards > 1 && shards > capacity)
+            shards /= 2;
+        return shards;
+    }
+
+public: // state
+
+    size_type   shards()    const   { return m_shards.size(); }
+    size_type   capacity()  const   { return m_capacity; }
+
+    bool        empty()     const   { return size() == 0; }
+
+    size_type size() const
+    {
+        size_type result = 0;
+        for(const auto& x : m_shards)
+        {
+            shared_lock lock(x->mutex);
+            result += x->cache.size();
+        }
+        return result;
+    }
+
+    statistics_type statistics() const
+    {
+        statistics_type result = statistics_type();
+        for(size_type i = 0; i < shards(); ++i)
+        {
+            const statistics_type x = shard_statistics(i);
+            result += x;
+            result.coalesced += x.coalesced;
+        }
+        return result;
+    }
+
+    statistics_type shard_statistics(size_type i) const
+    {
+        limo_contract(i < shards(), "shard index out of range");
+        const shard_type& x = *m_shards[i];
+        shared_lock lock(x.mutex);
+        statistics_type result = statistics_type();
+        static_cast<CacheStatistics&>(result) = x.cache.statistics();
+        result.hits += x.shared_hits.get();
+        result.coalesced = x.coalesced;
+        return result;
+    }
+
+    size_type weight() const
+    {
+        size_type result = 0;
+        for(const auto& x : m_shards)
+        {
+            shared_lock lock(x->mutex);
+            result += x->cache.weight();
+        }
+        return result;
+    }
+
+    // see Cache::set_weigher, every shard bounds the weight of its part
+    void set_weigher(weigher_type weigher, size_type expected_size = 0)
+    {
+        for(auto& x : m_shards)
+        {
+            exclusive_lock lock(x->mutex);
+            x->cache.set_weigher(weigher, expected_size / shards());
+        }
+    }
+
+    // see Cache::set_ttl
+    void set_ttl(duration ttl)
+    {
+        for(auto& x : m_shards)
+        {
+            exclusive_lock lock(x->mutex);
+            x->cache.set_ttl(ttl);
+        }
+    }
+
+    bool contains(const key_type& key) const
+    {
+        const shard_type& x = shard_of(key);
+        shared_lock lock(x.mutex);
+        return x.cache.contains(key);
+    }
+
+public: // main interface
+
+    void clear()
+    {
+        for(auto& x : m_shards)
+        {
+            exclusive_lock lock(x->mutex);
+            x->cache.clear();
+            x->shared_hits.clear();
+            x->coalesced = 0;
+        }
+    }
+
+    cached_type get(const key_type& key) 
+    {
+        return get(key, std::integral_constant<bool, shared_hit_path>());
+    }
+
+    cached_type operator[](const key_type& key)
+    {
+        return get(key);
+    }
+
+    future_type get_async(const key_type& key)
+    {
+        shard_type& x = shard_of(key);
+        exclusive_lock lock(x.mutex);
+        harvest_finished(x);
+        if (const cached_type* value = x.cache.lookup(key))
+        {
+            std::promise<cached_type> ready;
+            ready.set_value(*value);
+            return ready.get_future().share();
+        }
+
+        auto flight = find_flight(x, key, lock);
+        if (flight != x.inflight.end())
+        {
+            future_type result = flight->second;
+            ++x.coalesced;
+            if (is_ready(result))
+                harvest(x, flight);
+            return result;
+        }
+
+        // launched outside of the lock, an empty future marks the key 
+        // meanwhile; the async computor is expected to return quickly
+        x.inflight.emplace(key, future_type());
+        lock.unlock();
+
+        future_type result;
+        try
+        {
+            result = m_executor ? launch(x, key) : m_compute_async(key);
+        }
+        catch(...)
+        {
+            lock.lock();
+            x.inflight.erase(key);
+            lock.unlock();
+            x.launched.notify_all();
+            throw;
+        }
+
+        lock.lock();
+        x.inflight[key] = result;
+        lock.unlock();
+        x.launched.notify_all();
+        return result;
+    }
+
+    // moves finished async computations into the cache, returns how many
+    // are still in flight
+    size_type collect()
+    {
+        size_type pending = 0;
+        for(auto& x : m_shards)
+        {
+            exclusive_lock lock(x->mutex);
+            harvest_ready(*x);
+            pending += x->inflight.size();
+        }
+        return pending;
+    }
+
+private: // implementation details
+
+#if __cplusplus >= 201703L
+    typedef std::shared_mutex                   mutex_type;
+#else
+    typedef std::shared_timed_mutex             mutex_type;
+#endif
+    typedef std::shared_lock<mutex_type>        shared_lock;
+    typedef std::unique_lock<mutex_type>        exclusive_lock;
+
+    // allocated one by one, neighbour shard locks should not share a line
+    struct shard_type
+    {
+        shard_type(computor_type computor, size_type capacity, strategy_type strategy)
+        : mutex()
+        , cache(computor, capacity, std::move(strategy))
+        , shared_hits()
+        , inflight()
+        , launched()
+        , finished(std::make_shared<finished_type>())
+        , poll_at(min_poll)
+        , coalesced(0)
+        {
+        }
+
+        mutable mutex_type      mutex;
+        cache_type              cache;
+        details::StripedCounter shared_hits; // counted outside of cache
+
+        // misses being computed, guarded by mutex. get() leaders insert
+        // and remove their entry, ready entries are from get_async(); 
+        // empty ones are still being launched by get_async()
+        typedef std::unordered_map<key_type, future_type> inflight_type;
+        inflight_type           inflight;
+        std::condition_variable_any launched;
+
+        // keys of finished executor tasks, shared with the tasks: they 
+        // may outlive the cache
+        struct finished_type
+        {
+            std::mutex              mutex;
+            std::vector<key_type>   keys;
+        };
+        std::shared_ptr<finished_type> finished;
+        size_type               poll_at;    // in flight count to poll all at
+
+        size_type               coalesced;
+    };
+
+    cached_type get(const key_type& key, std::true_type)
+    {
+        shard_type& x = shard_of(key);
+        {
+            shared_lock lock(x.mutex);
+            if (const cached_type* value = x.cache.find(key))
+            {
+                x.shared_hits.add();
+                return *value;
+            }
+        }
+        // may have been inserted meanwhile, operator[] checks again
+        return get(key, std::false_type());
+    }
+
+    cached_type get(const key_type& key, std::false_type)
+    {
+        shard_type& x = shard_of(key);
+        exclusive_lock lock(x.mutex);
+        harvest_finished(x);
+        if (const cached_type* value = x.cache.lookup(key))
+            return *value;
+
+        auto flight = find_flight(x, key, lock);
+        if (flight != x.inflight.end())
+        {
+            future_type result = flight->second;
+            ++x.coalesced;
+            if (!is_ready(result))
+            {
+                lock.unlock();
+                result.wait();
+                lock.lock();
+                flight = x.inflight.find(key);
+            }
+            if (flight != x.inflight.end() && flight->second.valid() && is_ready(flight->second))
+                harvest(x, flight);
+            lock.unlock();
+            return result.get();
+        }
+
+        std::promise<cached_type> promise;
+        x.inflight.emplace(key, promise.get_future().share());
+        lock.unlock();
+
+        try
+        {
+            const auto start = std::chrono::steady_clock::now();
+            cached_type value = m_compute(key);
+            const double cost = details::seconds_since(start);
+
+            lock.lock();
+            x.cache.insert(key, value, cost);
+            x.inflight.erase(key);
+            lock.unlock();
+
+            promise.set_value(value);
+            return value;
+        }
+        catch(...)
+        {
+            if (!lock.owns_lock())
+                lock.lock();
+            x.inflight.erase(key);
+            lock.unlock();
+
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+    }
+
+    // entry of the key in flight, after its launch if get_async() is 
+    // launching it: the lock is released while waiting
+    typename shard_type::inflight_type::iterator find_flight(
+        shard_type& x, const key_type& key, exclusive_lock& lock)
+    {
+        auto flight = x.inflight.find(key);
+        while(flight != x.inflight.end() && !flight->second.valid())
+        {
+            x.launched.wait(lock);
+            flight = x.inflight.find(key);
+        }
+        return flight;
+    }
+
+    static bool is_ready(const future_type& x)
+    {
+        return x.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // finished async computation: value goes to the cache, failure is 
+    // only kept by the future holders
+    typename shard_type::inflight_type::iterator harvest(
+        shard_type& x, typename shard_type::inflight_type::iterator flight)
+    {
+        try
+        {
+            x.cache.insert(flight->first, flight->second.get());
+        }
+        catch(...)
+        {
+            // failed computations are not cached, callers get the 
+            // exception from the future
+        }
+        return x.inflight.erase(flight);
+    }
+
+    void harvest_ready(shard_type& x)
+    {
+        for(auto flight = x.inflight.begin(); flight != x.inflight.end(); )
+        {
+            if (flight->second.valid() && is_ready(flight->second))
+                flight = harvest(x, flight);
+            else
+                ++flight;
+        }
+        x.poll_at = std::max(size_type(min_poll), 2 * x.inflight.size());
+    }
+
+    // under the exclusive lock: caches what the executor tasks finished,
+    // and polls all flights when their count doubled since the last time,
+    // so futures of an async computor are collected at O(1) amortized
+    void harvest_finished(shard_type& x)
+    {
+        std::vector<key_type> keys;
+        {
+            std::lock_guard<std::mutex> lock(x.finished->mutex);
+            keys.swap(x.finished->keys);
+        }
+        for(const auto& key : keys)
+        {
+            auto flight = x.inflight.find(key);
+            if (flight != x.inflight.end() && flight->second.valid() && is_ready(flight->second))
+                harvest(x, flight);
+        }
+
+        if (x.inflight.size() >= x.poll_at)
+            harvest_ready(x);
+    }
+
+    // runs the computor on the executor, the task reports its key to the 
+    // shard when done
+    future_type launch(shard_type& x, const key_type& key)
+    {
+        auto promise = std::make_shared<std::promise<cached_type> >();
+        auto finished = x.finished;
+        computor_type computor = m_compute;
+        m_executor([computor, promise, finished, key]() {
+            try
+            {
+                promise->set_value(computor(key));
+            }
+            catch(...)
+            {
+                promise->set_exception(std::current_exception());
+            }
+            std::lock_guard<std::mutex> lock(finished->mutex);
+            finished->keys.push_back(key);
+        });
+        return promise->get_future().share();
+    }
+
+    shard_type& shard_of(const key_type& key)
+    {
+        return *m_shards[shard_index(key)];
+    }
+
+    const shard_type& shard_of(const key_type& key) const
+    {
+        return *m_shards[shard_index(key)];
+    }
+
+    size_type shard_index(const key_type& key) const
+    {
+        // high half of the mixed hash, storages use the low bits
+        const std::size_t h = details::flat::mix(std::hash<key_type>()(key));
+        return (h >> (sizeof(std::size_t) * 4)) & m_mask;
+    }
+
+private:
+    std::vector<std::unique_ptr<shard_type> > m_shards;
+    size_type           m_mask;
+    size_type           m_capacity;
+    computor_type       m_compute;
+    executor_type       m_executor;         // empty: m_compute_async
+    async_computor_type m_compute_async;
+
+    static const size_type min_poll = 16;
+};
+
+    
+} // namespace limo
+
+//------------------------------------------------------------------------------
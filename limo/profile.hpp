@@ -29,13 +29,26 @@ SOFTWARE.
 // include local:
 #include <limo/assert.hpp>
 #include <limo/bases.hpp>
+#include <limo/profile/Clock.hpp>
+#include <limo/profile/Collector.hpp>
+#include <limo/profile/Export.hpp>
+#include <limo/profile/Info.hpp>
+#include <limo/profile/Sampler.hpp>
+#include <limo/profile/ThreadData.hpp>
 
 // include std:
 #include <chrono>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 
 
 // forward declarations:
@@ -46,7 +59,7 @@ SOFTWARE.
     #define limo_profile_scope(id)  (void)(0)
 #else
     #define limo_profile_scope(id)  \
-        static limo::profile::details::Info& limo_scope_profile_info = limo::profile::details::DB::create_info(id); \
+        static const limo::profile::details::Scope& limo_scope_profile_info = limo::profile::details::DB::create_scope(id); \
         limo::profile::details::InfoUpdater limo_scope_profile_updater(limo_scope_profile_info) 
 #endif    
 
@@ -58,62 +71,84 @@ namespace limo
 {
     namespace profile
     {
-        typedef std::chrono::high_resolution_clock  clock_type;
-        
         namespace details
         {
-            struct Info
+            // Registry of scopes and of per thread counters. Scopes and
+            // threads register under a lock once; the counting itself goes 
+            // to the ThreadData of the calling thread without contention.
+            // ThreadData outlives its thread, so totals keep the work of 
+            // finished threads.
+            class DB
             {
-                const char* id;
-                size_t      calls;
-                clock_type::duration   total_time;
-                
-                Info(const char* id_): id(id_), calls(0), total_time(0) {}
-                
-                template <class TDuration>
-                typename TDuration::rep total() const 
-                { 
-                    return std::chrono::duration_cast<TDuration>(total_time).count();
+            public:
+                static inline DB& instance()
+                {
+                    static DB instance;
+                    return instance;
                 }
 
-                template <class TDuration>
-                typename TDuration::rep average() const 
-                { 
-                    // limo_assert(calls > 0, "should never happen");
-                    if (calls == 0)
-                        return 0;
-                    return std::chrono::duration_cast<TDuration>(total_time/calls).count();
+                static const Scope& create_scope(const char* id)
+                {
+                    Untracked untracked;
+                    DB& db = instance();
+                    std::lock_guard<std::mutex> lock(db.m_mutex);
+
+                    limo_assert(db.m_scopes.size() < m_max_objects, "too many objects to profile");
+
+                    db.m_scopes.push_back(Scope{id, db.m_scopes.size()});
+                    return db.m_scopes.back();
                 }
 
-                double relative(const clock_type::duration& time) const 
+                static ThreadData& thread_data()
                 {
-                    limo_assert(time.count() > 0, "expeced nonzero time");
+                    ThreadData*& data = current_thread_data();
+                    if (data == nullptr)
+                        data = &owned_thread_data();
+                    return *data;
+                }
 
-                    auto preserve_radix = 1000;
-                    auto enu  = 100 * preserve_radix * total_time.count();
-                    auto denom = time.count();
-                    return  double(enu / denom) / preserve_radix;
+                // SIGPROF handler of the sampling mode, see Sampler
+                static void on_sample()
+                {
+                    if (ThreadData* data = current_thread_data())
+                        data->sample();
+                    else
+                        unattributed_samples().fetch_add(1, std::memory_order_relaxed);
                 }
-            };
 
+                // operator new hook of the allocation tracker, see 
+                // limo/profile_allocations.hpp; only threads that already
+                // profiled count, creating their data would allocate
+                static void on_allocation(size_t size)
+                {
+                    if (ThreadData* data = current_thread_data())
+                        data->allocate(size);
+                }
 
-            class DB
-            {
-            public:
-                static inline DB& instance()
+                // true once the allocation tracker is linked in
+                static std::atomic<bool>& allocations_tracked()
                 {
-                    static DB instance;
-                    return instance;
+                    static std::atomic<bool> result(false);
+                    return result;
                 }
 
-                static Info& create_info(const char* id)
+                // samples of all threads: at the root of the call tree (no 
+                // scope was active) and in threads that never profiled
+                static size_t samples_outside_scopes()
                 {
                     DB& db = instance();
+                    std::lock_guard<std::mutex> lock(db.m_mutex);
 
-                    limo_assert(db.m_data.size() < m_max_objects, "too many objects to profile");
+                    size_t result = size_t(unattributed_samples().load(std::memory_order_relaxed));
+                    for(const auto& thread : db.m_threads)
+                        result += size_t(thread->node(ThreadData::root).samples.get());
+                    return result;
+                }
 
-                    db.m_data.emplace_back(Info(id));
-                    return db.m_data.back();
+                // profiler cost per scope, subtracted from the results
+                static Overhead overhead()
+                {
+                    return instance().m_overhead;
                 }
 
                 static clock_type::duration time()
@@ -121,49 +156,353 @@ namespace limo
                     return clock_type::now() - instance().m_start;
                 }
 
+                // totals of all threads, top max_lines by time
                 static std::vector<Info> results(size_t max_lines)
                 {
-                    auto greater_time = [](const Info& x, const Info& y) { 
-                        return x.total_time > y.total_time; 
-                    };
+                    DB& db = instance();
+                    std::lock_guard<std::mutex> lock(db.m_mutex);
+
+                    std::vector<Info> infos;
+                    for(const auto& scope : db.m_scopes)
+                        infos.push_back(Info(scope.id));
+
+                    for(const auto& thread : db.m_threads)
+                        add(infos, *thread);
+                    return top(infos, max_lines);
+                }
+
+                // call tree of all threads, paths of the same scopes merged
+                static CallTree call_tree()
+                {
+                    DB& db = instance();
+                    std::lock_guard<std::mutex> lock(db.m_mutex);
+
+                    CallTree tree(1, CallNode(nullptr, ThreadData::npos));
+                    for(const auto& thread : db.m_threads)
+                    {
+                        const size_t size = thread->size();
+                        std::vector<size_t> merged(size, 0);
+                        for(size_t i = 1; i < size; ++i)
+                        {
+                            const Node& x = thread->node(i);
+                            const size_t parent = merged[x.parent];
+
+                            size_t to = 0;
+                            for(auto child : tree[parent].children)
+                                if (tree[child].scope == x.scope)
+                                    to = child;
+                            if (to == 0)
+                            {
+                                to = tree.size();
+                                tree.push_back(CallNode(db.m_scopes[x.scope].id, x.scope));
+                                tree[parent].children.push_back(to);
+                            }
+
+                            merged[i] = to;
+                            tree[to].calls += x.calls.get();
+                            tree[to].inclusive += Ticks::to_duration(x.inclusive.get());
+                            tree[to].exclusive += Ticks::to_duration(x.exclusive.get());
+                            tree[to].samples += x.samples.get();
+                        }
+                    }
+                    return tree;
+                }
+
+                // calls not profiled because a call tree was full
+                static size_t dropped()
+                {
+                    DB& db = instance();
+                    std::lock_guard<std::mutex> lock(db.m_mutex);
+
+                    size_t result = 0;
+                    for(const auto& thread : db.m_threads)
+                        result += thread->dropped();
+                    return result;
+                }
+
+                static bool counters_enabled()
+                {
+                    return instance().m_counters_enabled.load(std::memory_order_relaxed);
+                }
+
+                // Threads open their counters with the next profiled scope.
+                // False, and nothing enabled, if the calling thread cannot 
+                // open any.
+                static bool start_counters()
+                {
+                    CounterGroup probe;
+                    instance().m_counters_enabled.store(probe.is_open(), std::memory_order_relaxed);
+                    return probe.is_open();
+                }
+
+                static void stop_counters()
+                {
+                    instance().m_counters_enabled.store(false, std::memory_order_relaxed);
+                }
 
-                    auto db = instance().m_data;
-                    sort(db.begin(), db.end(), greater_time);
+                // per thread capacity of the timeline, 0 when it is off
+                static size_t timeline_capacity()
+                {
+                    return instance().m_timeline_capacity.load(std::memory_order_relaxed);
+                }
 
-                    auto up = std::min(max_lines, db.size());
-                    db.erase(db.begin()+up, db.end());
-                    return db;
+                // Threads start pushing calls to their rings with the next
+                // profiled scope, a ring made earlier keeps its capacity. 
+                // The collector drains the rings while the timeline is on 
+                // and keeps the newest history events.
+                static void start_timeline(size_t capacity, size_t history)
+                {
+                    DB& db = instance();
+                    db.m_collector.start(history, std::chrono::milliseconds(1));
+                    db.m_timeline_capacity.store(capacity, std::memory_order_relaxed);
+                }
+
+                static void stop_timeline()
+                {
+                    DB& db = instance();
+                    db.m_timeline_capacity.store(0, std::memory_order_relaxed);
+                    db.m_collector.stop();
+                }
+
+                // calls collected from the timelines of all threads, by begin time
+                static std::vector<TraceEvent> timeline()
+                {
+                    DB& db = instance();
+                    const auto collected = db.m_collector.events();
+
+                    std::lock_guard<std::mutex> lock(db.m_mutex);
+                    std::vector<TraceEvent> events;
+                    events.reserve(collected.size());
+                    for(const auto& x : collected)
+                    {
+                        events.push_back(TraceEvent{
+                            db.m_scopes[x.scope].id, 
+                            x.thread, 
+                            Ticks::to_duration(x.begin - db.m_start_ticks), 
+                            Ticks::to_duration(x.end - x.begin)});
+                    }
+
+                    std::sort(events.begin(), events.end(), [](const TraceEvent& x, const TraceEvent& y) {
+                        return x.begin < y.begin;
+                    });
+                    return events;
+                }
+
+                // timeline events lost: to full rings or out of the history
+                static size_t timeline_dropped()
+                {
+                    DB& db = instance();
+                    size_t result = size_t(db.m_collector.discarded());
+
+                    std::lock_guard<std::mutex> lock(db.m_mutex);
+                    for(const auto& thread : db.m_threads)
+                    {
+                        if (const EventRing* ring = thread->ring())
+                            result += size_t(ring->dropped());
+                    }
+                    return result;
+                }
+
+                // totals of each thread, in the order threads started profiling
+                static std::vector<std::vector<Info>> thread_results(size_t max_lines)
+                {
+                    DB& db = instance();
+                    std::lock_guard<std::mutex> lock(db.m_mutex);
+
+                    std::vector<std::vector<Info>> result;
+                    for(const auto& thread : db.m_threads)
+                    {
+                        std::vector<Info> infos;
+                        for(const auto& scope : db.m_scopes)
+                            infos.push_back(Info(scope.id));
+
+                        add(infos, *thread);
+                        result.push_back(top(infos, max_lines));
+                    }
+                    return result;
                 }
 
             private:
                 DB()
-                : m_start(clock_type::now())
+                : m_overhead(calibrate())
+                , m_start(clock_type::now())
+                , m_start_ticks(Ticks::start())
+                , m_timeline_capacity(0)
+                , m_counters_enabled(false)
+                , m_collector([this](std::vector<EventRing::Event>& out) { drain(out); })
                 {
-                    m_data.reserve(m_max_objects);
+                    m_scopes.reserve(m_max_objects);
+                }
+
+                // for the collector only, the single consumer of the rings
+                void drain(std::vector<EventRing::Event>& out)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    for(const auto& thread : m_threads)
+                    {
+                        if (EventRing* ring = thread->ring())
+                            ring->drain(out);
+                    }
+                }
+
+                // constant initialized thread_local and atomic: no guard, 
+                // safe in a signal handler
+                static ThreadData*& current_thread_data()
+                {
+                    static thread_local ThreadData* data = nullptr;
+                    return data;
+                }
+
+                static std::atomic<std::uint64_t>& unattributed_samples()
+                {
+                    static std::atomic<std::uint64_t> result(0);
+                    return result;
+                }
+
+                static ThreadData& owned_thread_data()
+                {
+                    static thread_local std::shared_ptr<ThreadData> data = instance().add_thread();
+                    return *data;
+                }
+
+                std::shared_ptr<ThreadData> add_thread()
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+
+                    m_threads.push_back(std::make_shared<ThreadData>(m_threads.size(), m_overhead));
+                    return m_threads.back();
+                }
+
+                // Runs empty scopes the way InfoUpdater does, best of a few 
+                // rounds: inner is the time an empty scope measures itself,
+                // outer what it costs its caller. Also settles the tick rate.
+                static Overhead calibrate()
+                {
+                    Ticks::frequency();
+
+                    const int rounds = 10;
+                    const int calls = 1000;
+                    Overhead result{std::numeric_limits<std::int64_t>::max(), 
+                                    std::numeric_limits<std::int64_t>::max()};
+
+                    ThreadData probe(ThreadData::npos);
+                    Frame frame;
+                    for(int round = 0; round < rounds; ++round)
+                    {
+                        std::int64_t inner = 0;
+                        const auto outer = Ticks::start();
+                        for(int i = 0; i < calls; ++i)
+                        {
+                            probe.enter(frame, 0);
+                            const auto start = Ticks::start();
+                            const auto elapsed = Ticks::stop() - start;
+                            probe.leave(frame, elapsed);
+                            inner += elapsed;
+                        }
+                        result.outer = std::min(result.outer, (Ticks::stop() - outer) / calls);
+                        result.inner = std::min(result.inner, inner / calls);
+                    }
+                    return result;
+                }
+
+                static void add(std::vector<Info>& infos, const ThreadData& thread)
+                {
+                    const size_t size = thread.size();
+                    for(size_t i = 1; i < size; ++i)
+                    {
+                        const Node& x = thread.node(i);
+                        Info& info = infos[x.scope];
+
+                        info.calls += x.calls.get();
+                        info.samples += x.samples.get();
+                        info.allocations += x.allocations.get();
+                        info.bytes += x.bytes.get();
+                        info.counter_mask |= thread.counter_mask();
+                        for(size_t counter = 0; counter < counter_count; ++counter)
+                            info.counters[counter] += x.counters[counter].get();
+                        info.latency.add(*x.latency);
+                        info.self_time += Ticks::to_duration(x.exclusive.get());
+                        if (!nested_in_itself(thread, i))
+                            info.total_time += Ticks::to_duration(x.inclusive.get());
+                    }
+                }
+
+                // indirect recursion: the scope of node is also an ancestor
+                static bool nested_in_itself(const ThreadData& thread, size_t node)
+                {
+                    const size_t scope = thread.node(node).scope;
+                    for(size_t i = thread.node(node).parent; i != ThreadData::root; i = thread.node(i).parent)
+                    {
+                        if (thread.node(i).scope == scope)
+                            return true;
+                    }
+                    return false;
+                }
+
+                static std::vector<Info> top(std::vector<Info> infos, size_t max_lines)
+                {
+                    auto greater_time = [](const Info& x, const Info& y) { 
+                        return x.total_time > y.total_time; 
+                    };
+
+                    infos.erase(std::remove_if(infos.begin(), infos.end(), 
+                        [](const Info& x) { return x.calls == 0; }), infos.end());
+                    sort(infos.begin(), infos.end(), greater_time);
+
+                    auto up = std::min(max_lines, infos.size());
+                    infos.erase(infos.begin()+up, infos.end());
+                    return infos;
                 }
 
                 static const size_t m_max_objects = 1000;
+
+                const Overhead m_overhead;
                 const clock_type::time_point m_start;
-                std::vector<Info> m_data;
+                const std::int64_t m_start_ticks;
+                std::atomic<size_t> m_timeline_capacity;
+                std::atomic<bool> m_counters_enabled;
+                std::mutex m_mutex;
+                std::vector<Scope> m_scopes;
+                std::vector<std::shared_ptr<ThreadData>> m_threads;
+                Collector m_collector;  // last: stops before the rest goes
             };
 
             
 
+            // keep in step with DB::calibrate
             struct InfoUpdater : limo::noncopyable
             {
-                Info&       m_info;
-                clock_type::time_point   m_start;
-
-                InfoUpdater(Info& info)
-                : m_info(info)
-                , m_start(clock_type::now())
+                ThreadData&     m_thread;
+                const size_t    m_scope;
+                const CounterGroup* m_counters;
+                Frame           m_frame;
+                std::int64_t    m_start;
+
+                // counters are read outside of the timed span, the time of
+                // a caller includes the reads of its children though
+                InfoUpdater(const Scope& scope)
+                : m_thread(DB::thread_data())
+                , m_scope(scope.index)
+                , m_counters(DB::counters_enabled() ? m_thread.counters() : nullptr)
                 {
+                    m_thread.enter(m_frame, m_scope);
+                    if (m_counters && !m_counters->read(m_frame.counters))
+                        m_counters = nullptr;
+                    m_start = Ticks::start();
                 }
 
                 ~InfoUpdater()
                 {
-                    ++(m_info.calls);
-                    m_info.total_time += clock_type::now() - m_start;
+                    const std::int64_t stop = Ticks::stop();
+
+                    CounterGroup::values_type counters;
+                    if (m_counters && m_counters->read(counters))
+                        m_thread.count(m_frame, counters);
+
+                    m_thread.leave(m_frame, stop - m_start);
+
+                    if (const size_t capacity = DB::timeline_capacity())
+                        m_thread.trace(m_scope, m_start, stop, capacity);
                 }
             };
 
@@ -174,52 +513,330 @@ namespace limo
         } // namespace details
 
 
-        std::ostream& results(std::ostream& o)
+        namespace details
+        {
+            inline std::ostream& print(std::ostream& o, const std::vector<Info>& db)
+            {   
+                using namespace std;
+                using namespace std::chrono;
+
+                typedef duration<double, micro> microseconds;
+
+                auto finish = DB::time();
+                
+                // output width
+                const size_t w_name = 20; 
+                const size_t w_rel = 6;
+                const size_t w_time = 10;
+                const size_t w_calls = 10;
+                const size_t w_latency = 10;
+                const size_t w_allocs = 11;
+
+                const double percentiles[] = {50, 90, 99, 99.9};
+                const char* percentile_names[] = {"p50 usec", "p90 usec", "p99 usec", "p99.9 usec"};
+
+                // with the allocation tracker only
+                const bool allocations = DB::allocations_tracked().load(std::memory_order_relaxed);
+
+                auto br = [&](){
+                    o   << left << ".-" << setfill('-')
+                        << setw(w_name)     << "-" << "-.-"
+                        << setw(w_rel)      << "-" << "-.-"
+                        << setw(w_time)     << "-" << "-.-"
+                        << setw(w_time)     << "-" << "-.-"
+                        << setw(w_time)     << "-" << "-.-"
+                        << setw(w_calls)    << "-" << "-.-"
+                        << setw(w_calls)    << "-" << "-.-";
+                    if (allocations)
+                        o   << setw(w_allocs)   << "-" << "-.-"
+                            << setw(w_allocs)   << "-" << "-.-";
+                    for(size_t i = 0; i < 4; ++i)
+                        o << setw(w_latency) << "-" << "-.-";
+                    o   << setw(w_latency)  << "-" << "-.\n";
+                };
+                br();
+                o   << setfill(' ') << left << "| "
+                    << setw(w_name)       << "function"   << " | "
+                    << setw(w_rel)      <<  "% time"    << " | "
+                    << setw(w_time)     <<  "time msec"      << " | "
+                    << setw(w_time)     <<  "self msec"      << " | "
+                    << setw(w_time)     <<  "average"   << " | "
+                    << setw(w_calls)    <<  "calls"     << " | "
+                    << setw(w_calls)    <<  "samples"   << " | ";
+                if (allocations)
+                    o   << setw(w_allocs)   <<  "allocs/call"   << " | "
+                        << setw(w_allocs)   <<  "bytes/call"    << " | ";
+                for(auto name : percentile_names)
+                    o << setw(w_latency) << name << " | ";
+                o   << setw(w_latency)  <<  "max usec"  << " |\n";
+                br();
+                for(const auto& info : db)
+                {
+                    o   << setfill(' ') << "| "
+                        << left << setw(w_name)   << info.id << " | "
+                        << right << setw(w_rel) << fixed << setprecision(2) 
+                            << info.relative(finish) << " | "
+                        << right << setw(w_time) << info.total<milliseconds>() << " | "
+                        << right << setw(w_time) << info.self<milliseconds>() << " | "
+                        << right << setw(w_time) << info.average<milliseconds>()  << " | "
+                        << right << setw(w_calls) << info.calls  << " | "
+                        << right << setw(w_calls) << info.samples  << " | "
+                        << setprecision(1);
+                    if (allocations)
+                        o   << setw(w_allocs) << info.allocations_per_call() << " | "
+                            << setw(w_allocs) << info.bytes_per_call() << " | ";
+                    for(auto p : percentiles)
+                        o << setw(w_latency) << info.percentile<microseconds>(p) << " | ";
+                    o   << setw(w_latency) << info.max<microseconds>() << " |\n";
+                    br();
+                }
+                return o;
+            }
+
+            // hardware counters, "-" for those no thread could count
+            inline std::ostream& print_counters(std::ostream& o, const std::vector<Info>& db)
+            {   
+                using namespace std;
+
+                // output width
+                const size_t w_name = 20; 
+                const size_t w_counter = 14;
+                const size_t w_ipc = 6;
+
+                const size_t columns[] = {
+                    counter_cycles, counter_instructions, 
+                    counter_l1_misses, counter_llc_misses, counter_branch_misses
+                };
+
+                auto br = [&](){
+                    o   << left << ".-" << setfill('-')
+                        << setw(w_name)     << "-" << "-.-"
+                        << setw(w_ipc)      << "-" << "-.-";
+                    for(size_t i = 1; i < 5; ++i)
+                        o << setw(w_counter) << "-" << "-.-";
+                    o   << setw(w_counter)  << "-" << "-.\n";
+                };
+                br();
+                o   << setfill(' ') << left << "| "
+                    << setw(w_name)     << "function"   << " | "
+                    << setw(w_ipc)      << "IPC"        << " | ";
+                for(auto counter : columns)
+                    o << setw(w_counter) << counter_name(counter) << (counter == columns[4] ? " |\n" : " | ");
+                br();
+                for(const auto& info : db)
+                {
+                    o   << setfill(' ') << "| "
+                        << left << setw(w_name)   << info.id << " | "
+                        << right << setw(w_ipc) << fixed << setprecision(2);
+                    if (info.ipc() > 0)
+                        o << info.ipc() << " | ";
+                    else
+                        o << "-" << " | ";
+                    for(auto counter : columns)
+                    {
+                        o << setw(w_counter);
+                        if (info.has_counter(counter))
+                            o << info.counters[counter];
+                        else
+                            o << "-";
+                        o << (counter == columns[4] ? " |\n" : " | ");
+                    }
+                    br();
+                }
+                return o;
+            }
+
+            // call tree, children indented under their caller, hottest first
+            inline std::ostream& print(std::ostream& o, const CallTree& tree)
+            {   
+                using namespace std;
+                using namespace std::chrono;
+
+                auto finish = DB::time();
+                
+                // output width
+                const size_t w_name = 32; 
+                const size_t w_rel = 6;
+                const size_t w_time = 10;
+                const size_t w_calls = 10;
+                const size_t w_indent = 2;
+
+                auto br = [&](){
+                    o   << left << ".-" << setfill('-')
+                        << setw(w_name)     << "-" << "-.-"
+                        << setw(w_rel)      << "-" << "-.-"
+                        << setw(w_time)     << "-" << "-.-"
+                        << setw(w_time)     << "-" << "-.-"
+                        << setw(w_calls)    << "-" << "-.-"
+                        << setw(w_calls)    << "-" << "-.\n";
+                };
+
+                std::function<void(size_t, size_t)> row = [&](size_t index, size_t depth) {
+                    const CallNode& node = tree[index];
+                    if (node.id)
+                    {
+                        o   << setfill(' ') << "| "
+                            << left << setw(w_name) << (string(w_indent * depth, ' ') + node.id) << " | "
+                            << right << setw(w_rel) << fixed << setprecision(2) 
+                                << relative(node.inclusive, finish) << " | "
+                            << right << setw(w_time) << duration_cast<milliseconds>(node.inclusive).count() << " | "
+                            << right << setw(w_time) << duration_cast<milliseconds>(node.exclusive).count() << " | "
+                            << right << setw(w_calls) << node.calls  << " | "
+                            << right << setw(w_calls) << node.samples  << " |\n";
+                    }
+
+                    auto children = node.children;
+                    sort(children.begin(), children.end(), [&tree](size_t x, size_t y) {
+                        return tree[x].inclusive > tree[y].inclusive;
+                    });
+                    for(auto child : children)
+                        row(child, node.id ? depth + 1 : depth);
+                };
+
+                br();
+                o   << setfill(' ') << left << "| "
+                    << setw(w_name)       << "call tree"   << " | "
+                    << setw(w_rel)      <<  "% time"    << " | "
+                    << setw(w_time)     <<  "time msec"      << " | "
+                    << setw(w_time)     <<  "self msec"      << " | "
+                    << setw(w_calls)    <<  "calls"     << " | "
+                    << setw(w_calls)    <<  "samples"   << " |\n";
+                br();
+                row(0, 0);
+                br();
+                return o;
+            }
+
+            const size_t max_lines = 20;
+
+        } // namespace details
+
+
+        // totals of all threads
+        inline std::ostream& results(std::ostream& o)
         {   
             #if defined(LIMO_DISABLE_PROFILER)
                 return o << "profiler disabled";
             #endif
 
             using namespace limo::profile::details;
-            using namespace std;
-            using namespace std::chrono;
 
-            const size_t max_lines = 20;
-            auto db = DB::results(max_lines);
-            auto finish = DB::time();
-            
-            // output width
-            const size_t w_name = 20; 
-            const size_t w_rel = 6;
-            const size_t w_time = 10;
-            const size_t w_calls = 10;
-
-            auto br = [&](){
-                o   << left << ".-" << setfill('-')
-                    << setw(w_name)     << "-" << "-.-"
-                    << setw(w_rel)      << "-" << "-.-"
-                    << setw(w_time)     << "-" << "-.-"
-                    << setw(w_time)     << "-" << "-.-"
-                    << setw(w_calls)    << "-" << "-.\n";
-            };
-            br();
-            o   << setfill(' ') << left << "| "
-                << setw(w_name)       << "function"   << " | "
-                << setw(w_rel)      <<  "% time"    << " | "
-                << setw(w_time)     <<  "time msec"      << " | "
-                << setw(w_time)     <<  "average"   << " | "
-                << setw(w_calls)    <<  "calls"     << " |\n";
-            br();
-            for(const auto& info : db)
+            const auto flat = DB::results(max_lines);
+            print(o, flat);
+            if (any_of(flat.begin(), flat.end(), [](const Info& x) { return x.counter_mask != 0; }))
+                print_counters(o, flat);
+            print(o, DB::call_tree());
+            if (const size_t dropped = DB::dropped())
+                o << dropped << " calls not profiled, call tree is full\n";
+            if (const size_t outside = DB::samples_outside_scopes())
+                o << outside << " samples outside of profiled scopes\n";
+
+            typedef std::chrono::duration<double, std::nano> nanoseconds;
+            const Overhead overhead = DB::overhead();
+            o   << std::fixed << std::setprecision(1) << "profiler overhead subtracted: " 
+                << nanoseconds(Ticks::to_duration(overhead.inner)).count() << " ns per scope, "
+                << nanoseconds(Ticks::to_duration(overhead.outer)).count() << " ns per nested scope\n";
+            return o;
+        }
+
+        // totals, per thread totals and the call tree as one JSON object
+        inline std::ostream& json(std::ostream& o)
+        {   
+            using namespace limo::profile::details;
+
+            const size_t all_lines = size_t(-1);
+            return write_json(o, DB::results(all_lines), DB::thread_results(all_lines), DB::call_tree());
+        }
+
+        // totals and per thread totals, a row per scope
+        inline std::ostream& csv(std::ostream& o)
+        {   
+            using namespace limo::profile::details;
+
+            const size_t all_lines = size_t(-1);
+            return write_csv(o, DB::results(all_lines), DB::thread_results(all_lines));
+        }
+
+        // Timeline: every thread pushes its calls (begin and end of each 
+        // profiled scope) to a lock-free ring of events_per_thread, a 
+        // background collector drains the rings and keeps the newest 
+        // history calls. Calls that find their ring full are dropped.
+        inline void start_timeline(size_t events_per_thread = 1 << 16, 
+                                   size_t history = details::Collector::default_history)
+        {
+            details::DB::start_timeline(events_per_thread, history);
+        }
+
+        inline void stop_timeline()
+        {
+            details::DB::stop_timeline();
+        }
+
+        // the timeline in Chrome trace_event format, for chrome://tracing
+        // and other trace viewers
+        inline std::ostream& chrome_trace(std::ostream& o)
+        {   
+            using namespace limo::profile::details;
+
+            const auto events = DB::timeline();
+            return write_chrome_trace(o, events, DB::timeline_dropped());
+        }
+
+        // Sampling: SIGPROF every 1/frequency s of CPU time counts a 
+        // sample for the innermost profiled scope of the running thread,
+        // shown in the samples columns of results(). Covers time in code 
+        // without scopes of its own at a fixed cost per second. False if
+        // signals or the timer are not available.
+        inline bool start_sampling(unsigned frequency = 1000)
+        {
+            details::DB::instance();
+            return details::Sampler::start(frequency, &details::DB::on_sample);
+        }
+
+        inline void stop_sampling()
+        {
+            details::Sampler::stop();
+        }
+
+        // Hardware counters: cycles, instructions, L1 and LLC misses and
+        // branch mispredictions of each scope, shown in a table of their 
+        // own by results(). Each profiled call then costs two read() 
+        // syscalls. False if perf_event_open is not permitted, e.g. by 
+        // /proc/sys/kernel/perf_event_paranoid, or not supported.
+        inline bool start_counters()
+        {
+            return details::DB::start_counters();
+        }
+
+        inline void stop_counters()
+        {
+            details::DB::stop_counters();
+        }
+
+        // call tree of all threads
+        inline std::ostream& call_tree(std::ostream& o)
+        {   
+            #if defined(LIMO_DISABLE_PROFILER)
+                return o << "profiler disabled";
+            #endif
+
+            return details::print(o, details::DB::call_tree());
+        }
+
+        // a table per thread, in the order threads started profiling
+        inline std::ostream& thread_results(std::ostream& o)
+        {   
+            #if defined(LIMO_DISABLE_PROFILER)
+                return o << "profiler disabled";
+            #endif
+
+            using namespace limo::profile::details;
+
+            const auto threads = DB::thread_results(max_lines);
+            for(size_t i = 0; i < threads.size(); ++i)
             {
-                o   << setfill(' ') << "| "
-                    << left << setw(w_name)   << info.id << " | "
-                    << right << setw(w_rel) << fixed << setprecision(2) 
-                        << info.relative(finish) << " | "
-                    << right << setw(w_time) << info.total<milliseconds>() << " | "
-                    << right << setw(w_time) << info.average<milliseconds>()  << " | "
-                    << right << setw(w_calls) << info.calls  << " |\n";
-                br();
+                o << "thread " << i << "\n";
+                print(o, threads[i]);
             }
             return o;
         }
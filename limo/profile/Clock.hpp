@@ -0,0 +1,138 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+
+// include std:
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #define LIMO_PROFILE_HAS_TSC
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+#endif
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+    namespace profile
+    {
+        typedef std::chrono::high_resolution_clock  clock_type;
+
+        namespace details
+        {
+            // Time sources of the profiler: start() and stop() read ticks
+            // around a scope, to_duration() converts a sum of ticks for the 
+            // report.
+
+            // ticks of clock_type
+            struct ChronoTicks
+            {
+                static std::int64_t start() { return clock_type::now().time_since_epoch().count(); }
+                static std::int64_t stop()  { return start(); }
+
+                static double frequency() 
+                { 
+                    return double(clock_type::period::den) / clock_type::period::num; 
+                }
+
+                static clock_type::duration to_duration(std::int64_t ticks)
+                {
+                    return clock_type::duration(ticks);
+                }
+            };
+
+        #if defined(LIMO_PROFILE_HAS_TSC)
+            // Time stamp counter, a few ns per read instead of a clock 
+            // call. Needs an invariant TSC (any x86 of the last decade), 
+            // its rate is measured against steady_clock once. lfence keeps
+            // start() from running ahead of the code before the scope, 
+            // rdtscp waits for the scope to finish.
+            struct TscTicks
+            {
+                static std::int64_t start()
+                { 
+                    _mm_lfence();
+                    return std::int64_t(__rdtsc()); 
+                }
+
+                static std::int64_t stop()
+                { 
+                    unsigned int aux;
+                    return std::int64_t(__rdtscp(&aux)); 
+                }
+
+                // ticks per second
+                static double frequency()
+                {
+                    static const double result = calibrate();
+                    return result;
+                }
+
+                static clock_type::duration to_duration(std::int64_t ticks)
+                {
+                    return std::chrono::duration_cast<clock_type::duration>(
+                        std::chrono::duration<double>(ticks / frequency()));
+                }
+
+            private:
+                static double calibrate()
+                {
+                    typedef std::chrono::steady_clock steady;
+
+                    const auto since = steady::now();
+                    const auto ticks = start();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                    const auto elapsed = stop() - ticks;
+                    const std::chrono::duration<double> seconds = steady::now() - since;
+                    return elapsed / seconds.count();
+                }
+            };
+        #endif
+
+            // LIMO_PROFILE_TSC selects the time stamp counter where there is one
+        #if defined(LIMO_PROFILE_TSC) && defined(LIMO_PROFILE_HAS_TSC)
+            typedef TscTicks    Ticks;
+        #else
+            typedef ChronoTicks Ticks;
+        #endif
+
+        } // namespace details
+    } // namespace profile
+} // namespace limo
+
+//------------------------------------------------------------------------------
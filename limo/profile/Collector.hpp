@@ -0,0 +1,172 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/bases.hpp>
+#include <limo/profile/EventRing.hpp>
+
+// include std:
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+    namespace profile
+    {
+        namespace details
+        {
+            // Background thread that drains the event rings of all threads
+            // every interval into a bounded history, keeping the newest 
+            // events. Producers never wait for it. drain appends the 
+            // pending events of every ring and is called under the lock of
+            // the collector only, so each ring has a single consumer.
+            class Collector : limo::noncopyable
+            {
+            public:
+                typedef EventRing::Event event_type;
+                typedef std::function<void(std::vector<event_type>&)> drain_type;
+
+                static const std::size_t default_history = 1 << 20;
+
+                explicit Collector(drain_type drain)
+                : m_drain(drain)
+                , m_running(false)
+                , m_history_capacity(default_history)
+                , m_discarded(0)
+                {
+                }
+
+                ~Collector()
+                {
+                    stop();
+                }
+
+                void start(std::size_t history, std::chrono::milliseconds interval)
+                {
+                    std::lock_guard<std::mutex> control(m_control);
+                    stop_thread();
+
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_history_capacity = history;
+                    m_running = true;
+                    m_thread = std::thread([this, interval]() { run(interval); });
+                }
+
+                // joins the thread after a last drain
+                void stop()
+                {
+                    std::lock_guard<std::mutex> control(m_control);
+                    stop_thread();
+                    collect();
+                }
+
+                void collect()
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    collect_locked();
+                }
+
+                // history after draining the rings, oldest first
+                std::vector<event_type> events()
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    collect_locked();
+                    return std::vector<event_type>(m_history.begin(), m_history.end());
+                }
+
+                // events pushed out of the history by newer ones
+                std::uint64_t discarded()
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    return m_discarded;
+                }
+
+            private:
+                void stop_thread()
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        m_running = false;
+                    }
+                    m_wake.notify_all();
+                    if (m_thread.joinable())
+                        m_thread.join();
+                }
+
+                void run(std::chrono::milliseconds interval)
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    while (m_running)
+                    {
+                        collect_locked();
+                        m_wake.wait_for(lock, interval, [this]() { return !m_running; });
+                    }
+                }
+
+                void collect_locked()
+                {
+                    m_buffer.clear();
+                    m_drain(m_buffer);
+                    for(const auto& x : m_buffer)
+                        m_history.push_back(x);
+
+                    while (m_history.size() > m_history_capacity)
+                    {
+                        m_history.pop_front();
+                        ++m_discarded;
+                    }
+                }
+
+                const drain_type            m_drain;
+                std::mutex                  m_control;  // start and stop
+                std::mutex                  m_mutex;
+                std::condition_variable     m_wake;
+                std::thread                 m_thread;
+                bool                        m_running;
+                std::size_t                 m_history_capacity;
+                std::uint64_t               m_discarded;
+                std::vector<event_type>     m_buffer;
+                std::deque<event_type>      m_history;
+            };
+
+        } // namespace details
+    } // namespace profile
+} // namespace limo
+
+//------------------------------------------------------------------------------
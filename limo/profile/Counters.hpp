@@ -0,0 +1,195 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/bases.hpp>
+
+// include std:
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+    #define LIMO_PROFILE_HAS_COUNTERS
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+    namespace profile
+    {
+        namespace details
+        {
+            // hardware events counted per scope in the counters mode
+            enum counter_id
+            {
+                counter_cycles,
+                counter_instructions,
+                counter_l1_misses,      // L1 data cache read misses
+                counter_llc_misses,     // last level cache misses
+                counter_branch_misses,
+                counter_count
+            };
+
+            inline const char* counter_name(std::size_t counter)
+            {
+                static const char* const names[counter_count] = {
+                    "cycles", "instructions", "L1 misses", "LLC misses", "branch misses"
+                };
+                return names[counter];
+            }
+
+            // Hardware counters of the calling thread, in user mode, via 
+            // perf_event_open as one group, so they run and are read 
+            // together: one read() per snapshot. Counters the kernel does 
+            // not permit (perf_event_paranoid, containers) or the CPU does
+            // not have stay closed and read as 0; with none open, or off 
+            // Linux, the group is not open at all.
+            class CounterGroup : limo::noncopyable
+            {
+            public:
+                typedef std::array<std::uint64_t, counter_count> values_type;
+
+                CounterGroup()
+                : m_leader(-1)
+                , m_opened(0)
+                , m_mask(0)
+                {
+                #if defined(LIMO_PROFILE_HAS_COUNTERS)
+                    for(std::size_t counter = 0; counter < counter_count; ++counter)
+                    {
+                        const int fd = open(counter, m_leader);
+                        if (fd < 0)
+                            continue;
+
+                        if (m_leader < 0)
+                            m_leader = fd;
+                        m_fds[m_opened] = fd;
+                        m_slots[m_opened++] = counter;
+                        m_mask |= 1u << counter;
+                    }
+                #endif
+                }
+
+                ~CounterGroup()
+                {
+                #if defined(LIMO_PROFILE_HAS_COUNTERS)
+                    for(std::size_t i = 0; i < m_opened; ++i)
+                        close(m_fds[i]);
+                #endif
+                }
+
+                bool is_open() const { return m_opened > 0; }
+
+                // bit i set if counter i is counted
+                unsigned mask() const { return m_mask; }
+
+                // counts since the group was opened
+                bool read(values_type& values) const
+                {
+                    values.fill(0);
+                #if defined(LIMO_PROFILE_HAS_COUNTERS)
+                    if (m_opened == 0)
+                        return false;
+
+                    std::uint64_t buffer[1 + counter_count];    // nr, values
+                    const ssize_t size = ssize_t(sizeof(std::uint64_t) * (1 + m_opened));
+                    if (::read(m_leader, buffer, size_t(size)) != size)
+                        return false;
+
+                    for(std::size_t i = 0; i < m_opened && i < buffer[0]; ++i)
+                        values[m_slots[i]] = buffer[1 + i];
+                    return true;
+                #else
+                    return false;
+                #endif
+                }
+
+            private:
+            #if defined(LIMO_PROFILE_HAS_COUNTERS)
+                static int open(std::size_t counter, int leader)
+                {
+                    perf_event_attr attr;
+                    std::memset(&attr, 0, sizeof(attr));
+                    attr.size = sizeof(attr);
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+                    attr.read_format = PERF_FORMAT_GROUP;
+
+                    const std::uint64_t l1_read_miss = PERF_COUNT_HW_CACHE_L1D | 
+                        (PERF_COUNT_HW_CACHE_OP_READ << 8) | 
+                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+                    switch (counter)
+                    {
+                    case counter_cycles:
+                        attr.type = PERF_TYPE_HARDWARE;
+                        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                        break;
+                    case counter_instructions:
+                        attr.type = PERF_TYPE_HARDWARE;
+                        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                        break;
+                    case counter_l1_misses:
+                        attr.type = PERF_TYPE_HW_CACHE;
+                        attr.config = l1_read_miss;
+                        break;
+                    case counter_llc_misses:
+                        attr.type = PERF_TYPE_HARDWARE;
+                        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                        break;
+                    default:
+                        attr.type = PERF_TYPE_HARDWARE;
+                        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                        break;
+                    }
+
+                    // this thread, any CPU
+                    return int(syscall(__NR_perf_event_open, &attr, 0, -1, leader, PERF_FLAG_FD_CLOEXEC));
+                }
+            #endif
+
+                int             m_leader;
+                std::size_t     m_opened;
+                unsigned        m_mask;
+                int             m_fds[counter_count];
+                std::size_t     m_slots[counter_count];     // counter of each fd
+            };
+
+        } // namespace details
+    } // namespace profile
+} // namespace limo
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,147 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/assert.hpp>
+#include <limo/bases.hpp>
+
+// include std:
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+    namespace profile
+    {
+        namespace details
+        {
+            // Single producer, single consumer ring of trace events. The 
+            // owner thread pushes without locks or read-modify-writes and
+            // never waits: when the ring is full the event is dropped and
+            // counted. The consumer (the collector, one at a time) drains 
+            // it. head and tail are a cache line apart, and the producer 
+            // keeps a copy of tail, so it reads the consumer's line only 
+            // when the ring looks full.
+            class EventRing : limo::noncopyable
+            {
+            public:
+                // one call of a profiled scope, times in Ticks
+                struct Event
+                {
+                    std::uint32_t   scope;
+                    std::uint32_t   thread;
+                    std::int64_t    begin;
+                    std::int64_t    end;
+                };
+
+                // capacity is rounded up to a power of two
+                explicit EventRing(std::size_t capacity)
+                : m_mask(round_up(capacity) - 1)
+                , m_events(new Event[m_mask + 1])
+                {
+                    m_head.store(0, std::memory_order_relaxed);
+                    m_tail.store(0, std::memory_order_relaxed);
+                    m_dropped.store(0, std::memory_order_relaxed);
+                }
+
+                // producer only; false if the ring was full
+                bool push(const Event& x)
+                {
+                    const std::uint64_t head = m_head.load(std::memory_order_relaxed);
+                    if (head - m_cached_tail > m_mask)
+                    {
+                        m_cached_tail = m_tail.load(std::memory_order_acquire);
+                        if (head - m_cached_tail > m_mask)
+                        {
+                            m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, 
+                                            std::memory_order_relaxed);
+                            return false;
+                        }
+                    }
+
+                    m_events[head & m_mask] = x;
+                    m_head.store(head + 1, std::memory_order_release);
+                    return true;
+                }
+
+                // consumer only: append the pending events to out
+                std::size_t drain(std::vector<Event>& out)
+                {
+                    const std::uint64_t tail = m_tail.load(std::memory_order_relaxed);
+                    const std::uint64_t head = m_head.load(std::memory_order_acquire);
+                    for(std::uint64_t i = tail; i < head; ++i)
+                        out.push_back(m_events[i & m_mask]);
+
+                    m_tail.store(head, std::memory_order_release);
+                    return std::size_t(head - tail);
+                }
+
+                std::size_t capacity() const { return m_mask + 1; }
+
+                // any thread: events lost to a full ring
+                std::uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+            private:
+                static std::size_t round_up(std::size_t x)
+                {
+                    limo_assert(x > 0, "empty ring");
+
+                    std::size_t result = 1;
+                    while (result < x)
+                        result <<= 1;
+                    return result;
+                }
+
+                typedef std::atomic<std::uint64_t> index_type;
+
+                const std::size_t           m_mask;
+                std::unique_ptr<Event[]>    m_events;
+                std::atomic<std::uint64_t>  m_dropped;
+
+                // producer side
+                index_type                  m_head;
+                std::uint64_t               m_cached_tail = 0;
+                char                        m_head_padding[64 - sizeof(index_type) - sizeof(std::uint64_t)];
+
+                // consumer side
+                index_type                  m_tail;
+                char                        m_tail_padding[64 - sizeof(index_type)];
+            };
+
+        } // namespace details
+    } // namespace profile
+} // namespace limo
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,242 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/profile/Info.hpp>
+
+// include std:
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <ostream>
+#include <vector>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+    namespace profile
+    {
+        namespace details
+        {
+            // Writers of the profile for other tools. Times are integer
+            // nanoseconds in JSON and CSV, microseconds in the Chrome 
+            // trace_event format, which is what trace viewers expect.
+
+            inline long long nanoseconds(clock_type::duration x)
+            {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(x).count();
+            }
+
+            inline void write_json_string(std::ostream& o, const char* x)
+            {
+                o << '"';
+                for(; *x; ++x)
+                {
+                    const unsigned char c = static_cast<unsigned char>(*x);
+                    if (c == '"' || c == '\\')
+                        o << '\\' << *x;
+                    else if (c < 0x20)
+                    {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        o << escaped;
+                    }
+                    else
+                        o << *x;
+                }
+                o << '"';
+            }
+
+            inline void write_csv_string(std::ostream& o, const char* x)
+            {
+                o << '"';
+                for(; *x; ++x)
+                {
+                    if (*x == '"')
+                        o << '"';
+                    o << *x;
+                }
+                o << '"';
+            }
+
+            const double export_percentiles[] = {50, 90, 99, 99.9};
+            const char* const export_percentile_names[] = {"p50_ns", "p90_ns", "p99_ns", "p999_ns"};
+
+            inline void write_json(std::ostream& o, const Info& info)
+            {
+                o << "{\"id\":";
+                write_json_string(o, info.id);
+                o   << ",\"calls\":" << info.calls
+                    << ",\"total_ns\":" << nanoseconds(info.total_time)
+                    << ",\"self_ns\":" << nanoseconds(info.self_time);
+                for(size_t i = 0; i < 4; ++i)
+                {
+                    o   << ",\"" << export_percentile_names[i] << "\":" 
+                        << info.percentile<std::chrono::nanoseconds>(export_percentiles[i]);
+                }
+                o << ",\"max_ns\":" << info.max<std::chrono::nanoseconds>();
+                if (info.counter_mask)
+                {
+                    const char* separator = "";
+                    o << ",\"counters\":{";
+                    for(size_t counter = 0; counter < counter_count; ++counter)
+                    {
+                        if (!info.has_counter(counter))
+                            continue;
+                        o << separator;
+                        write_json_string(o, counter_name(counter));
+                        o << ":" << info.counters[counter];
+                        separator = ",";
+                    }
+                    o << "}";
+                }
+                o << "}";
+            }
+
+            inline void write_json(std::ostream& o, const std::vector<Info>& infos)
+            {
+                o << "[";
+                for(size_t i = 0; i < infos.size(); ++i)
+                {
+                    o << (i ? ",\n" : "\n");
+                    write_json(o, infos[i]);
+                }
+                o << "]";
+            }
+
+            inline void write_json(std::ostream& o, const CallTree& tree, size_t index)
+            {
+                const CallNode& node = tree[index];
+                o << "{\"id\":";
+                if (node.id)
+                    write_json_string(o, node.id);
+                else
+                    o << "null";
+                o   << ",\"calls\":" << node.calls
+                    << ",\"inclusive_ns\":" << nanoseconds(node.inclusive)
+                    << ",\"exclusive_ns\":" << nanoseconds(node.exclusive)
+                    << ",\"children\":[";
+                for(size_t i = 0; i < node.children.size(); ++i)
+                {
+                    o << (i ? "," : "");
+                    write_json(o, tree, node.children[i]);
+                }
+                o << "]}";
+            }
+
+            // {"scopes": totals, "threads": [{"thread": n, "scopes": ...}], 
+            //  "call_tree": root}
+            inline std::ostream& write_json(std::ostream& o, 
+                const std::vector<Info>& totals, 
+                const std::vector<std::vector<Info>>& threads,
+                const CallTree& tree)
+            {
+                o << "{\"scopes\":";
+                write_json(o, totals);
+                o << ",\n\"threads\":[";
+                for(size_t i = 0; i < threads.size(); ++i)
+                {
+                    o << (i ? ",\n" : "\n") << "{\"thread\":" << i << ",\"scopes\":";
+                    write_json(o, threads[i]);
+                    o << "}";
+                }
+                o << "],\n\"call_tree\":";
+                write_json(o, tree, 0);
+                return o << "}\n";
+            }
+
+            // a row per scope, thread "all" for the totals
+            inline std::ostream& write_csv(std::ostream& o, 
+                const std::vector<Info>& totals, 
+                const std::vector<std::vector<Info>>& threads)
+            {
+                o << "thread,id,calls,total_ns,self_ns";
+                for(auto name : export_percentile_names)
+                    o << "," << name;
+                o << ",max_ns\n";
+
+                auto row = [&o](const char* thread, const Info& info) {
+                    o << thread << ",";
+                    write_csv_string(o, info.id);
+                    o   << "," << info.calls
+                        << "," << nanoseconds(info.total_time)
+                        << "," << nanoseconds(info.self_time);
+                    for(auto p : export_percentiles)
+                        o << "," << info.percentile<std::chrono::nanoseconds>(p);
+                    o << "," << info.max<std::chrono::nanoseconds>() << "\n";
+                };
+
+                for(const auto& info : totals)
+                    row("all", info);
+
+                for(size_t i = 0; i < threads.size(); ++i)
+                {
+                    const std::string thread = std::to_string(i);
+                    for(const auto& info : threads[i])
+                        row(thread.c_str(), info);
+                }
+                return o;
+            }
+
+            // Chrome trace_event format: a complete ("X") event per call, 
+            // lost events in otherData
+            inline std::ostream& write_chrome_trace(std::ostream& o, 
+                const std::vector<TraceEvent>& events, 
+                size_t dropped)
+            {
+                typedef std::chrono::duration<double, std::micro> microseconds;
+
+                const auto precision = o.precision(3);
+                const auto flags = o.setf(std::ios::fixed, std::ios::floatfield);
+
+                o << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+                for(size_t i = 0; i < events.size(); ++i)
+                {
+                    const TraceEvent& x = events[i];
+                    o << (i ? ",\n" : "\n") << "{\"name\":";
+                    write_json_string(o, x.id);
+                    o   << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << x.thread
+                        << ",\"ts\":" << microseconds(x.begin).count()
+                        << ",\"dur\":" << microseconds(x.duration).count() << "}";
+                }
+                o << "\n],\"otherData\":{\"dropped\":" << dropped << "}}\n";
+
+                o.precision(precision);
+                o.flags(flags);
+                return o;
+            }
+
+        } // namespace details
+    } // namespace profile
+} // namespace limo
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,151 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+
+// include std:
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+    namespace profile
+    {
+        namespace details
+        {
+            // Log-linear layout of latency buckets, as in HdrHistogram: 
+            // values below 2^sub_bits have a bucket each, every power of 
+            // two above is split into 2^sub_bits buckets. A bucket knows 
+            // its values to 1/2^sub_bits (6.25%) in fixed memory; values 
+            // of 2^max_bits ticks and more count in the last bucket.
+            struct HistogramLayout
+            {
+                static const int            sub_bits = 4;
+                static const int            max_bits = 40;
+                static const std::size_t    sub_buckets = std::size_t(1) << sub_bits;
+                static const std::size_t    buckets = sub_buckets + (max_bits - sub_bits) * sub_buckets;
+
+                static std::size_t index(std::int64_t value)
+                {
+                    const std::uint64_t x = value > 0 ? std::uint64_t(value) : 0;
+                    if (x < sub_buckets)
+                        return std::size_t(x);
+
+                    const int bit = highest_bit(x);
+                    if (bit >= max_bits)
+                        return buckets - 1;
+
+                    const std::size_t mantissa = std::size_t(x >> (bit - sub_bits)) & (sub_buckets - 1);
+                    return sub_buckets + (bit - sub_bits) * sub_buckets + mantissa;
+                }
+
+                // largest value that falls into bucket i
+                static std::int64_t highest(std::size_t i)
+                {
+                    if (i < sub_buckets)
+                        return std::int64_t(i);
+
+                    const int bit = int((i - sub_buckets) / sub_buckets) + sub_bits;
+                    const std::uint64_t mantissa = sub_buckets + i % sub_buckets;
+                    return std::int64_t(((mantissa + 1) << (bit - sub_bits)) - 1);
+                }
+
+                static int highest_bit(std::uint64_t x)
+                {
+                #if defined(__GNUC__)
+                    return 63 - __builtin_clzll(x);
+                #else
+                    int result = 0;
+                    while (x >>= 1)
+                        ++result;
+                    return result;
+                #endif
+                }
+            };
+
+            // latency histogram in ticks, plain counts merged from threads
+            struct Histogram
+            {
+                typedef std::array<std::uint64_t, HistogramLayout::buckets> counts_type;
+
+                counts_type     counts;
+                std::int64_t    max;
+
+                Histogram(): counts(), max(0) {}
+
+                // THistogram: get(i) of each bucket and get_max()
+                template <class THistogram>
+                void add(const THistogram& x)
+                {
+                    for(std::size_t i = 0; i < counts.size(); ++i)
+                        counts[i] += x.get(i);
+                    max = std::max(max, x.get_max());
+                }
+
+                std::uint64_t count() const
+                {
+                    std::uint64_t result = 0;
+                    for(auto x : counts)
+                        result += x;
+                    return result;
+                }
+
+                // smallest value that p percent of the samples do not 
+                // exceed, within the bucket precision; 0 if empty
+                std::int64_t percentile(double p) const
+                {
+                    const std::uint64_t total = count();
+                    if (total == 0)
+                        return 0;
+
+                    const double rank = std::ceil(p / 100 * double(total));
+                    const std::uint64_t wanted = std::max<std::uint64_t>(1, std::uint64_t(rank));
+
+                    std::uint64_t seen = 0;
+                    for(std::size_t i = 0; i < counts.size(); ++i)
+                    {
+                        seen += counts[i];
+                        if (seen >= wanted)
+                            return std::min(HistogramLayout::highest(i), max);
+                    }
+                    return max;
+                }
+            };
+
+        } // namespace details
+    } // namespace profile
+} // namespace limo
+
+//------------------------------------------------------------------------------
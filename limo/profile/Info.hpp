@@ -0,0 +1,180 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/assert.hpp>
+#include <limo/profile/Clock.hpp>
+#include <limo/profile/Counters.hpp>
+#include <limo/profile/Histogram.hpp>
+
+// include std:
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+    namespace profile
+    {
+        namespace details
+        {
+            // a profiled scope, registered once by its limo_profile_scope
+            struct Scope
+            {
+                const char* id;
+                size_t      index;
+            };
+
+            // percent of time, with 3 digits after the point
+            inline double relative(const clock_type::duration& part, const clock_type::duration& time)
+            {
+                limo_assert(time.count() > 0, "expeced nonzero time");
+
+                auto preserve_radix = 1000;
+                auto enu  = 100 * preserve_radix * part.count();
+                auto denom = time.count();
+                return  double(enu / denom) / preserve_radix;
+            }
+
+            // totals of a scope, merged over threads or of one thread;
+            // total_time counts a scope nested in itself once, self_time 
+            // is the time outside of child scopes, latency has every call;
+            // samples are those taken while the scope was the innermost;
+            // counters are hardware events, those in counter_mask counted;
+            // allocations and bytes are operator new calls while innermost
+            struct Info
+            {
+                typedef std::array<std::uint64_t, counter_count> counters_type;
+
+                const char* id;
+                size_t      calls;
+                clock_type::duration   total_time;
+                clock_type::duration   self_time;
+                Histogram   latency;
+                size_t      samples;
+                counters_type   counters;
+                unsigned        counter_mask;
+                size_t      allocations;
+                size_t      bytes;
+                
+                Info(const char* id_)
+                : id(id_), calls(0), total_time(0), self_time(0), samples(0)
+                , counters(), counter_mask(0), allocations(0), bytes(0)
+                {}
+
+                double allocations_per_call() const { return calls ? double(allocations) / calls : 0; }
+                double bytes_per_call() const { return calls ? double(bytes) / calls : 0; }
+
+                bool has_counter(size_t counter) const { return (counter_mask >> counter) & 1; }
+
+                // instructions per cycle, 0 if not counted
+                double ipc() const
+                {
+                    if (!has_counter(counter_cycles) || !has_counter(counter_instructions) || counters[counter_cycles] == 0)
+                        return 0;
+                    return double(counters[counter_instructions]) / double(counters[counter_cycles]);
+                }
+                
+                template <class TDuration>
+                typename TDuration::rep total() const 
+                { 
+                    return std::chrono::duration_cast<TDuration>(total_time).count();
+                }
+
+                template <class TDuration>
+                typename TDuration::rep self() const 
+                { 
+                    return std::chrono::duration_cast<TDuration>(self_time).count();
+                }
+
+                template <class TDuration>
+                typename TDuration::rep average() const 
+                { 
+                    // limo_assert(calls > 0, "should never happen");
+                    if (calls == 0)
+                        return 0;
+                    return std::chrono::duration_cast<TDuration>(total_time/calls).count();
+                }
+
+                double relative(const clock_type::duration& time) const 
+                {
+                    return details::relative(total_time, time);
+                }
+
+                // latency of a call that p percent of the calls do not exceed
+                template <class TDuration>
+                typename TDuration::rep percentile(double p) const 
+                { 
+                    return std::chrono::duration_cast<TDuration>(Ticks::to_duration(latency.percentile(p))).count();
+                }
+
+                template <class TDuration>
+                typename TDuration::rep max() const 
+                { 
+                    return std::chrono::duration_cast<TDuration>(Ticks::to_duration(latency.max)).count();
+                }
+            };
+
+            // node of the call tree merged over threads, root at index 0
+            struct CallNode
+            {
+                const char*             id;         // nullptr for the root
+                size_t                  scope;
+                size_t                  calls;
+                clock_type::duration    inclusive;
+                clock_type::duration    exclusive;
+                size_t                  samples;    // while innermost
+                std::vector<size_t>     children;   // indices in the tree
+
+                CallNode(const char* id_, size_t scope_)
+                : id(id_), scope(scope_), calls(0), inclusive(0), exclusive(0), samples(0)
+                {}
+            };
+
+            typedef std::vector<CallNode> CallTree;
+
+            // a call recorded by the timeline, times since the profiler start
+            struct TraceEvent
+            {
+                const char*             id;
+                size_t                  thread;
+                clock_type::duration    begin;
+                clock_type::duration    duration;
+            };
+
+        } // namespace details
+    } // namespace profile
+} // namespace limo
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,176 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+
+// include std:
+#include <atomic>
+#include <cerrno>
+#include <mutex>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define LIMO_PROFILE_HAS_SAMPLING
+    #include <signal.h>
+    #include <sys/time.h>
+#endif
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+    namespace profile
+    {
+        namespace details
+        {
+            // Statistical sampling: setitimer(ITIMER_PROF) sends SIGPROF 
+            // every 1/frequency s of CPU time of the process, to one of the
+            // threads that are running, and the handler calls on_sample in
+            // that thread. on_sample must be async signal safe. stop() 
+            // puts back a previous SIGPROF handler; in place of the default
+            // action, which would end the process on a late signal, the 
+            // own handler stays and ignores it. Where there are no POSIX
+            // signals, start() returns false.
+            class Sampler
+            {
+            public:
+                typedef void (*handler_type)();
+
+                static bool start(unsigned frequency, handler_type on_sample)
+                {
+                #if defined(LIMO_PROFILE_HAS_SAMPLING)
+                    if (frequency == 0 || frequency > 1000000 || on_sample == nullptr)
+                        return false;
+
+                    State& state = instance();
+                    std::lock_guard<std::mutex> lock(state.mutex);
+                    stop_locked(state);
+
+                    handler().store(on_sample, std::memory_order_relaxed);
+
+                    struct sigaction action;
+                    sigemptyset(&action.sa_mask);
+                    action.sa_flags = SA_RESTART;
+                    action.sa_handler = &on_signal;
+                    if (sigaction(SIGPROF, &action, &state.previous) != 0)
+                        return false;
+
+                    itimerval timer;
+                    // tv_usec must stay below a second: 1 Hz is tv_sec = 1
+                    timer.it_interval.tv_sec = time_t(1 / frequency);
+                    timer.it_interval.tv_usec = suseconds_t((1000000 / frequency) % 1000000);
+                    timer.it_value = timer.it_interval;
+                    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0)
+                    {
+                        sigaction(SIGPROF, &state.previous, nullptr);
+                        return false;
+                    }
+
+                    state.frequency = frequency;
+                    return true;
+                #else
+                    return false;
+                #endif
+                }
+
+                static void stop()
+                {
+                #if defined(LIMO_PROFILE_HAS_SAMPLING)
+                    State& state = instance();
+                    std::lock_guard<std::mutex> lock(state.mutex);
+                    stop_locked(state);
+                #endif
+                }
+
+                // samples per second of CPU time, 0 when stopped
+                static unsigned frequency()
+                {
+                #if defined(LIMO_PROFILE_HAS_SAMPLING)
+                    State& state = instance();
+                    std::lock_guard<std::mutex> lock(state.mutex);
+                    return state.frequency;
+                #else
+                    return 0;
+                #endif
+                }
+
+            private:
+            #if defined(LIMO_PROFILE_HAS_SAMPLING)
+                struct State
+                {
+                    std::mutex          mutex;
+                    unsigned            frequency = 0;
+                    struct sigaction    previous;
+                };
+
+                static State& instance()
+                {
+                    static State state;
+                    return state;
+                }
+
+                // constant initialized, safe to read in the handler
+                static std::atomic<handler_type>& handler()
+                {
+                    static std::atomic<handler_type> result(nullptr);
+                    return result;
+                }
+
+                static void on_signal(int)
+                {
+                    const int saved = errno;
+                    if (handler_type on_sample = handler().load(std::memory_order_relaxed))
+                        on_sample();
+                    errno = saved;
+                }
+
+                static void stop_locked(State& state)
+                {
+                    if (state.frequency == 0)
+                        return;
+
+                    itimerval timer = {};
+                    setitimer(ITIMER_PROF, &timer, nullptr);
+                    handler().store(nullptr, std::memory_order_relaxed);
+
+                    const bool default_action = !(state.previous.sa_flags & SA_SIGINFO) && 
+                                                state.previous.sa_handler == SIG_DFL;
+                    if (!default_action)
+                        sigaction(SIGPROF, &state.previous, nullptr);
+                    state.frequency = 0;
+                }
+            #endif
+            };
+
+        } // namespace details
+    } // namespace profile
+} // namespace limo
+
+//------------------------------------------------------------------------------
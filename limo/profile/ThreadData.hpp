@@ -0,0 +1,381 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/assert.hpp>
+#include <limo/bases.hpp>
+#include <limo/profile/Counters.hpp>
+#include <limo/profile/EventRing.hpp>
+#include <limo/profile/Histogram.hpp>
+
+// include std:
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+    namespace profile
+    {
+        namespace details
+        {
+            // value with a single writer (the owner thread) that other 
+            // threads may read: relaxed load and store, no locked 
+            // read-modify-write on the hot path
+            template <class T>
+            class Relaxed
+            {
+            public:
+                Relaxed(): m_value(0) {}
+
+                T get() const { return m_value.load(std::memory_order_relaxed); }
+                void set(T x) { m_value.store(x, std::memory_order_relaxed); }
+                void add(T x) { set(get() + x); }
+
+            private:
+                std::atomic<T> m_value;
+            };
+
+            // latency histogram of a node, written by the owner thread
+            class ThreadHistogram : limo::noncopyable
+            {
+            public:
+                void record(std::int64_t ticks)
+                {
+                    m_counts[HistogramLayout::index(ticks)].add(1);
+                    if (ticks > m_max.get())
+                        m_max.set(ticks);
+                }
+
+                std::uint64_t get(std::size_t i) const { return m_counts[i].get(); }
+                std::int64_t get_max() const { return m_max.get(); }
+
+            private:
+                std::array<Relaxed<std::uint64_t>, HistogramLayout::buckets> m_counts;
+                Relaxed<std::int64_t> m_max;
+            };
+
+            // Node of the call tree of one thread: a scope reached by a
+            // path of scopes from the root. A scope called directly from 
+            // itself stays in its node, so recursion does not grow the tree.
+            // scope and parent are set before the node is published, the
+            // counters are written by the owner thread only; first_child
+            // and next_sibling are owner thread bookkeeping. The latency
+            // of every call goes to the histogram of the node.
+            struct Node
+            {
+                std::size_t             scope;
+                std::size_t             parent;
+                Relaxed<std::uint64_t>  calls;
+                Relaxed<std::int64_t>   inclusive;  // Ticks
+                Relaxed<std::int64_t>   exclusive;  // without child scopes
+                Relaxed<std::uint64_t>  samples;    // while innermost, see sample()
+                Relaxed<std::uint64_t>  allocations;    // see allocate()
+                Relaxed<std::uint64_t>  bytes;
+                std::array<Relaxed<std::uint64_t>, counter_count> counters;
+                std::unique_ptr<ThreadHistogram> latency;
+                std::size_t             first_child;
+                std::size_t             next_sibling;
+            };
+
+            // an active scope on the stack of its thread
+            struct Frame
+            {
+                std::size_t     node;
+                bool            recursive;  // entered from its own node
+                std::int64_t    children;   // time spent in child scopes
+                std::int64_t    nested;     // scopes run inside this one
+                Frame*          outer;
+                CounterGroup::values_type counters;    // at entry
+            };
+
+            // Cost of the profiler in ticks, included in what it measures: 
+            // inner is in the time of every scope (the clock reads), outer
+            // in the time of its caller for every scope nested in it.
+            struct Overhead
+            {
+                std::int64_t    inner;
+                std::int64_t    outer;
+            };
+
+            // Marks allocations of the profiler itself on this thread, the
+            // allocation tracker does not count them for the scopes
+            struct Untracked : limo::noncopyable
+            {
+                Untracked() { ++depth(); }
+                ~Untracked() { --depth(); }
+
+                static int& depth()
+                {
+                    static thread_local int result = 0;
+                    return result;
+                }
+            };
+
+            // Call tree of one thread. Only the owner thread writes; 
+            // DB::results reads it at any time. Nodes are allocated in 
+            // blocks and published by a release store of the node count, 
+            // so a reader sees only fully built nodes. When the tree is 
+            // full, new paths are not profiled and are counted as dropped.
+            // The profiler overhead is subtracted from the time of a scope,
+            // the time never goes below that of its children.
+            class ThreadData : limo::noncopyable
+            {
+            public:
+                static const std::size_t block_size = 64;
+                static const std::size_t max_blocks = 256;
+                static const std::size_t max_nodes = block_size * max_blocks;
+                static const std::size_t npos = std::size_t(-1);
+                static const std::size_t root = 0;
+
+                explicit ThreadData(std::size_t number, Overhead overhead = Overhead{0, 0})
+                : m_number(number)
+                , m_overhead(overhead)
+                , m_top(nullptr)
+                , m_size(0)
+                , m_ring(nullptr)
+                {
+                    for(auto& block : m_blocks)
+                        block.store(nullptr, std::memory_order_relaxed);
+
+                    add_node(npos, npos);
+                }
+
+                ~ThreadData()
+                {
+                    for(auto& block : m_blocks)
+                        delete[] block.load(std::memory_order_relaxed);
+                    delete m_ring.load(std::memory_order_relaxed);
+                }
+
+                // owner thread only: push frame for scope, find or add its node
+                void enter(Frame& frame, std::size_t scope)
+                {
+                    Frame* const top = m_top.load(std::memory_order_relaxed);
+                    const std::size_t parent = top ? top->node : root;
+
+                    frame.recursive = parent != npos && parent != root && 
+                                      node(parent).scope == scope;
+                    frame.node = frame.recursive || parent == npos ? parent : child(parent, scope);
+                    frame.children = 0;
+                    frame.nested = 0;
+                    frame.outer = top;
+                    std::atomic_signal_fence(std::memory_order_release);
+                    m_top.store(&frame, std::memory_order_relaxed);
+                }
+
+                // owner thread only: pop frame, that ran for elapsed ticks
+                void leave(Frame& frame, std::int64_t elapsed)
+                {
+                    limo_assert(m_top.load(std::memory_order_relaxed) == &frame, "profiled scopes must nest");
+
+                    elapsed -= m_overhead.inner + frame.nested * m_overhead.outer;
+                    elapsed = std::max(elapsed, frame.children);
+
+                    Frame* const top = frame.outer;
+                    m_top.store(top, std::memory_order_relaxed);
+                    if (top)
+                    {
+                        top->children += elapsed;
+                        top->nested += frame.nested + 1;
+                    }
+
+                    if (frame.node == npos)
+                    {
+                        m_dropped.add(1);
+                        return;
+                    }
+
+                    Node& x = at(frame.node);
+                    x.calls.add(1);
+                    x.latency->record(elapsed);
+                    x.exclusive.add(elapsed - frame.children);
+                    if (!frame.recursive)
+                        x.inclusive.add(elapsed);
+                }
+
+                // Owner thread only, from a signal handler: count a sample
+                // for the innermost active scope, or the root outside of
+                // scopes. Async signal safe: the handler interrupts the 
+                // owner, enter() publishes a frame only once it is built.
+                void sample()
+                {
+                    const Frame* const top = m_top.load(std::memory_order_relaxed);
+                    std::atomic_signal_fence(std::memory_order_acquire);
+
+                    const std::size_t index = top ? top->node : root;
+                    if (index != npos)
+                        at(index).samples.add(1);
+                }
+
+                // owner thread only: an operator new of size bytes, counted 
+                // for the innermost scope; must not allocate itself
+                void allocate(std::size_t size)
+                {
+                    if (Untracked::depth())
+                        return;
+
+                    const Frame* const top = m_top.load(std::memory_order_relaxed);
+
+                    const std::size_t index = top ? top->node : root;
+                    if (index != npos)
+                    {
+                        Node& x = at(index);
+                        x.allocations.add(1);
+                        x.bytes.add(size);
+                    }
+                }
+
+                // owner thread only: the hardware counters of the thread, 
+                // opened on the first call; nullptr if none is permitted
+                const CounterGroup* counters()
+                {
+                    if (!m_counters)
+                    {
+                        Untracked untracked;
+                        m_counters.reset(new CounterGroup);
+                        m_counter_mask.set(m_counters->mask());
+                    }
+                    return m_counters->is_open() ? m_counters.get() : nullptr;
+                }
+
+                // owner thread only: add what the counters counted since 
+                // frame.counters to its node, once for a recursive scope
+                void count(const Frame& frame, const CounterGroup::values_type& now)
+                {
+                    if (frame.node == npos || frame.recursive)
+                        return;
+
+                    Node& x = at(frame.node);
+                    for(std::size_t i = 0; i < counter_count; ++i)
+                        x.counters[i].add(now[i] - frame.counters[i]);
+                }
+
+                // any thread: counters the thread could open, see CounterGroup
+                unsigned counter_mask() const { return m_counter_mask.get(); }
+
+                // owner thread only: add a call to the timeline, the ring 
+                // is made on the first call with the given capacity
+                void trace(std::size_t scope, std::int64_t begin, std::int64_t end, std::size_t capacity)
+                {
+                    EventRing* ring = m_ring.load(std::memory_order_relaxed);
+                    if (ring == nullptr)
+                    {
+                        Untracked untracked;
+                        ring = new EventRing(capacity);
+                        m_ring.store(ring, std::memory_order_release);
+                    }
+                    ring->push(EventRing::Event{std::uint32_t(scope), std::uint32_t(m_number), begin, end});
+                }
+
+                // nullptr if the thread never traced; the collector drains it
+                EventRing* ring() const { return m_ring.load(std::memory_order_acquire); }
+
+                // any thread: nodes [0, size()) are published, 0 is the root
+                std::size_t size() const { return m_size.load(std::memory_order_acquire); }
+
+                const Node& node(std::size_t index) const
+                {
+                    return m_blocks[index / block_size].load(std::memory_order_acquire)[index % block_size];
+                }
+
+                // calls not profiled because the tree was full
+                std::uint64_t dropped() const { return m_dropped.get(); }
+
+                // order in which threads started profiling, from 0
+                std::size_t number() const { return m_number; }
+
+            private:
+                Node& at(std::size_t index)
+                {
+                    return m_blocks[index / block_size].load(std::memory_order_relaxed)[index % block_size];
+                }
+
+                std::size_t child(std::size_t parent, std::size_t scope)
+                {
+                    std::size_t* link = &at(parent).first_child;
+                    for(; *link != npos; link = &at(*link).next_sibling)
+                    {
+                        if (at(*link).scope == scope)
+                            return *link;
+                    }
+
+                    const std::size_t index = add_node(scope, parent);
+                    if (index != npos)
+                        *link = index;
+                    return index;
+                }
+
+                std::size_t add_node(std::size_t scope, std::size_t parent)
+                {
+                    const std::size_t index = m_size.load(std::memory_order_relaxed);
+                    if (index == max_nodes)
+                        return npos;
+
+                    Untracked untracked;
+                    auto& block = m_blocks[index / block_size];
+                    Node* nodes = block.load(std::memory_order_relaxed);
+                    if (nodes == nullptr)
+                    {
+                        nodes = new Node[block_size];
+                        block.store(nodes, std::memory_order_release);
+                    }
+
+                    Node& x = nodes[index % block_size];
+                    x.scope = scope;
+                    x.parent = parent;
+                    x.latency.reset(new ThreadHistogram);
+                    x.first_child = npos;
+                    x.next_sibling = npos;
+                    m_size.store(index + 1, std::memory_order_release);
+                    return index;
+                }
+
+                const std::size_t           m_number;
+                const Overhead              m_overhead;
+                std::atomic<Frame*>         m_top;
+                std::atomic<std::size_t>    m_size;
+                Relaxed<std::uint64_t>      m_dropped;
+                std::atomic<EventRing*>     m_ring;
+                std::unique_ptr<CounterGroup> m_counters;
+                Relaxed<unsigned>           m_counter_mask;
+                std::atomic<Node*>          m_blocks[max_blocks];
+            };
+
+        } // namespace details
+    } // namespace profile
+} // namespace limo
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,122 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/profile.hpp>
+
+// include std:
+#include <cstdlib>
+#include <new>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+// Allocation tracker: replaces the global operator new and delete to count 
+// the calls and bytes of operator new for the innermost limo_profile_scope 
+// of the calling thread, shown as allocs/call and bytes/call by results().
+// Include in exactly one translation unit of the program, like 
+// limo/test_main.hpp. Allocations of the profiler itself are not counted,
+// nor those of threads before their first profiled scope and the aligned
+// overloads of C++17.
+
+namespace limo
+{
+    namespace profile
+    {
+        namespace details
+        {
+            inline void* tracked_allocate(std::size_t size)
+            {
+                #if !defined(LIMO_DISABLE_PROFILER)
+                    DB::on_allocation(size);
+                #endif
+
+                if (size == 0)
+                    size = 1;
+                for(;;)
+                {
+                    if (void* p = std::malloc(size))
+                        return p;
+
+                    std::new_handler handler = std::get_new_handler();
+                    if (!handler)
+                        throw std::bad_alloc();
+                    handler();
+                }
+            }
+
+            inline void* tracked_allocate(std::size_t size, const std::nothrow_t&) noexcept
+            {
+                try
+                {
+                    return tracked_allocate(size);
+                }
+                catch(...)
+                {
+                    return nullptr;
+                }
+            }
+
+            static const bool allocations_tracker = (DB::allocations_tracked().store(true), true);
+
+        } // namespace details
+    } // namespace profile
+} // namespace limo
+
+//------------------------------------------------------------------------------
+
+void* operator new(std::size_t size)
+{
+    return limo::profile::details::tracked_allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return limo::profile::details::tracked_allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return limo::profile::details::tracked_allocate(size, tag);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return limo::profile::details::tracked_allocate(size, tag);
+}
+
+void operator delete(void* p) noexcept                                  { std::free(p); }
+void operator delete[](void* p) noexcept                                { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept                     { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept                   { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept           { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept         { std::free(p); }
+
+//------------------------------------------------------------------------------
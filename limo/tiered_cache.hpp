@@ -0,0 +1,152 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+
+#pragma once
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/cache.hpp>
+#include <limo/cache/DiskStore.hpp>
+#include <limo/bases.hpp>
+
+// include std:
+#include <functional>
+#include <string>
+#include <utility>
+
+// forward declarations:
+
+
+//------------------------------------------------------------------------------
+
+namespace limo
+{
+
+
+// Two tier cache: a Cache in memory over a DiskStore on local disk.
+// Entries evicted from memory are demoted to the disk store instead of 
+// being dropped; a memory miss looks at the disk first and promotes the
+// entry back, only a miss in both tiers calls the computor. A key lives in
+// one tier at a time. Disk reads count as loads of the memory tier, so 
+// cost aware strategies see promotions as cheap. TTL deadlines do not 
+// follow entries to disk.
+template <
+    typename TKey, 
+    typename TValue, 
+    class TCacheStrategy = LRU<TKey>, 
+    class TStorage = NodeStorage >
+class TieredCache : limo::noncopyable
+{
+public:
+    typedef TieredCache<TKey, TValue, TCacheStrategy, TStorage> self_type;
+    typedef Cache<TKey, TValue, TCacheStrategy, TStorage>       cache_type;
+    typedef DiskStore<TKey, TValue>                             disk_type;
+
+    typedef typename cache_type::size_type          size_type;
+    typedef typename cache_type::key_type           key_type;
+    typedef typename cache_type::cached_type        cached_type;
+    typedef typename cache_type::computor_type      computor_type;
+    typedef typename cache_type::strategy_type      strategy_type;
+
+public: // ctors
+
+    // capacity: entries (or weight) in memory, disk_capacity: bytes on disk
+    TieredCache(
+        computor_type       computor, 
+        size_type           capacity, 
+        const std::string&  disk_path,
+        size_type           disk_capacity,
+        strategy_type       strategy = strategy_type()
+    )
+    : m_disk(disk_path, disk_capacity)
+    , m_memory([this, computor](const key_type& key) { return fetch(computor, key); }, 
+        capacity, std::move(strategy))
+    , m_promotions(0)
+    {
+        m_memory.set_eviction_listener([this](const key_type& key, cached_type&& value) {
+            m_disk.put(key, value);
+        });
+    }
+
+public: // state
+
+    size_type   size()      const   { return m_memory.size() + m_disk.size(); }
+    size_type   promotions() const  { return m_promotions; }
+
+    bool contains(const key_type& key) const 
+    { 
+        return m_memory.contains(key) || m_disk.contains(key); 
+    }
+
+    cache_type&         memory()        { return m_memory; }
+    const cache_type&   memory() const  { return m_memory; }
+    const disk_type&    disk()   const  { return m_disk; }
+
+public: // main interface
+
+    void clear()
+    {
+        m_memory.clear();
+        m_disk.clear();
+        m_promotions = 0;
+    }
+
+    cached_type& operator[](const key_type& key)
+    {
+        return m_memory[key];
+    }
+
+    // stores a value computed elsewhere, an older one on disk is dropped
+    cached_type& insert(const key_type& key, cached_type value)
+    {
+        m_disk.erase(key);
+        return m_memory.insert(key, std::move(value));
+    }
+
+private: // implementation details
+
+    cached_type fetch(const computor_type& computor, const key_type& key)
+    {
+        cached_type value;
+        if (m_disk.take(key, value))
+        {
+            ++m_promotions;
+            return value;
+        }
+        return computor(key);
+    }
+
+private:
+    // the memory tier demotes into the disk store: destroyed after it
+    disk_type   m_disk;
+    cache_type  m_memory;
+    size_type   m_promotions;
+};
+
+    
+} // namespace limo
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,274 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+
+// Single threaded limo::Cache benchmark: every strategy with both storage
+// backends on synthetic workloads (Zipf, uniform, scan over a hot set,
+// shifting working set) and on access traces given on the command line:
+//
+//  bench_cache [trace]...
+//
+// A trace is a text file with one integer key per line, or with the .bin
+// extension a raw array of little endian uint64 keys. Reported per run:
+// throughput, p50/p99 latency of a lookup (sampled in a second pass),
+// hit ratio and bytes allocated by the cache. The computor is trivial, so
+// the numbers are the overhead of the cache itself.
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/cache.hpp>
+#include <limo_examples/allocation_counter.hpp>
+
+// include std:
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// forward declarations:
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    typedef std::uint64_t           key_type;
+    typedef std::vector<key_type>   trace_type;
+
+    const std::size_t capacity = 10000;
+    const std::size_t universe = 100000;
+    const std::size_t operations = 1000000;
+    const std::size_t latency_sample = 8;     // every n-th lookup is timed
+
+    // keys 0..n-1 with P(k) ~ 1/(k+1)^theta
+    trace_type zipf(std::size_t n, double theta, std::size_t count, unsigned seed)
+    {
+        std::vector<double> cdf(n);
+        double sum = 0;
+        for(std::size_t k = 0; k < n; ++k)
+            cdf[k] = sum += 1.0 / std::pow(double(k + 1), theta);
+
+        std::mt19937_64 random(seed);
+        std::uniform_real_distribution<double> uniform(0, sum);
+        trace_type trace(count);
+        for(auto& x : trace)
+            x = std::lower_bound(cdf.begin(), cdf.end(), uniform(random)) - cdf.begin();
+        return trace;
+    }
+
+    trace_type uniform(std::size_t n, std::size_t count, unsigned seed)
+    {
+        std::mt19937_64 random(seed);
+        std::uniform_int_distribution<key_type> keys(0, n - 1);
+        trace_type trace(count);
+        for(auto& x : trace)
+            x = keys(random);
+        return trace;
+    }
+
+    // half of the accesses go to a hot set of half the capacity, the rest
+    // is a sequential scan that never repeats
+    trace_type scan_hot(std::size_t count, unsigned seed)
+    {
+        const trace_type hot = uniform(capacity / 2, count, seed);
+        trace_type trace(count);
+        key_type scan = universe;
+        for(std::size_t i = 0; i < count; ++i)
+            trace[i] = i % 2 ? hot[i] : scan++;
+        return trace;
+    }
+
+    // Zipf over a working set that moves to new keys every tenth of the run
+    trace_type shifting(std::size_t count, unsigned seed)
+    {
+        trace_type trace = zipf(universe / 4, 0.9, count, seed);
+        const std::size_t phase = count / 10;
+        for(std::size_t i = 0; i < count; ++i)
+            trace[i] += (i / phase) * (universe / 8);
+        return trace;
+    }
+
+    trace_type load_trace(const std::string& path)
+    {
+        trace_type trace;
+        const bool binary = path.size() > 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+        std::ifstream in(path, binary ? std::ios::binary : std::ios::in);
+        if (binary)
+        {
+            key_type key;
+            while(in.read(reinterpret_cast<char*>(&key), sizeof(key)))
+                trace.push_back(key);
+        }
+        else
+        {
+            key_type key;
+            while(in >> key)
+                trace.push_back(key);
+        }
+        return trace;
+    }
+
+    struct result_type
+    {
+        double          mops;
+        double          p50;    // ns
+        double          p99;    // ns
+        double          hit_ratio;
+        std::uint64_t   allocated;
+    };
+
+    key_type compute(const key_type& key)
+    {
+        return key * 3;
+    }
+
+    template <class TFactory>
+    result_type run(TFactory make, const trace_type& trace)
+    {
+        result_type result;
+        key_type sink = 0;
+        {
+            const std::uint64_t allocated = g_allocated.load();
+            auto cache = make();
+            const auto start = std::chrono::steady_clock::now();
+            for(const auto& key : trace)
+                sink += cache[key];
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            result.mops = double(trace.size()) / elapsed.count() / 1e6;
+            result.hit_ratio = cache.statistics().hit_ratio();
+            result.allocated = g_allocated.load() - allocated;
+        }
+        {
+            auto cache = make();
+            std::vector<double> latency;
+            latency.reserve(trace.size() / latency_sample + 1);
+            for(std::size_t i = 0; i < trace.size(); ++i)
+            {
+                if (i % latency_sample)
+                {
+                    sink += cache[trace[i]];
+                    continue;
+                }
+                const auto start = std::chrono::steady_clock::now();
+                sink += cache[trace[i]];
+                latency.push_back(std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - start).count());
+            }
+            std::sort(latency.begin(), latency.end());
+            result.p50 = latency.empty() ? 0 : latency[latency.size() / 2];
+            result.p99 = latency.empty() ? 0 : latency[latency.size() * 99 / 100];
+        }
+        if (sink == 42)  // keeps the lookups
+            std::cout << "";
+        return result;
+    }
+
+    void report(const std::string& name, const result_type& x)
+    {
+        std::cout   << std::setw(22) << std::left << name << std::right
+                    << std::fixed << std::setprecision(2)
+                    << std::setw(10) << x.mops
+                    << std::setw(10) << std::setprecision(0) << x.p50
+                    << std::setw(10) << x.p99
+                    << std::setw(9) << std::setprecision(2) << 100 * x.hit_ratio << "%"
+                    << std::setw(12) << std::setprecision(1) << double(x.allocated) / (1 << 20)
+                    << std::endl;
+    }
+
+    template <template <class> class TStrategy, class TStorage>
+    void bench(const std::string& name, const trace_type& trace,
+               std::function<TStrategy<key_type>()> strategy)
+    {
+        report(name, run([&strategy]() {
+            return limo::Cache<key_type, key_type, TStrategy<key_type>, TStorage>(
+                compute, capacity, strategy());
+        }, trace));
+    }
+
+    template <template <class> class TStrategy>
+    void bench_both(const std::string& name, const trace_type& trace,
+                    std::function<TStrategy<key_type>()> strategy)
+    {
+        bench<TStrategy, limo::NodeStorage>(name + "/node", trace, strategy);
+        bench<TStrategy, limo::FlatStorage>(name + "/flat", trace, strategy);
+    }
+
+    void bench_all(const std::string& workload, const trace_type& trace)
+    {
+        using namespace limo;
+
+        std::cout   << "\n" << workload << ": " << trace.size() << " lookups, capacity " << capacity << "\n"
+                    << std::setw(22) << std::left << "strategy/storage" << std::right
+                    << std::setw(10) << "Mops/s" << std::setw(10) << "p50 ns"
+                    << std::setw(10) << "p99 ns" << std::setw(10) << "hits"
+                    << std::setw(12) << "alloc MB" << std::endl;
+
+        bench_both<LRU>("LRU", trace, []() { return LRU<key_type>(); });
+        bench_both<IntrusiveLRU>("IntrusiveLRU", trace, []() { return IntrusiveLRU<key_type>(capacity); });
+        bench_both<Clock>("Clock", trace, []() { return Clock<key_type>(capacity); });
+        bench_both<LFU>("LFU", trace, []() { return LFU<key_type>(); });
+        bench_both<WTinyLFU>("WTinyLFU", trace, []() { return WTinyLFU<key_type>(capacity); });
+        bench_both<ARC>("ARC", trace, []() { return ARC<key_type>(capacity); });
+        bench_both<TwoQ>("TwoQ", trace, []() { return TwoQ<key_type>(capacity); });
+        bench_both<GreedyDualSize>("GreedyDualSize", trace, []() { return GreedyDualSize<key_type>(capacity); });
+    }
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            const trace_type trace = load_trace(argv[i]);
+            if (trace.empty())
+            {
+                std::cerr << argv[i] << ": no keys read" << std::endl;
+                return 1;
+            }
+            bench_all(argv[i], trace);
+        }
+        return 0;
+    }
+
+    bench_all("zipf 0.99", zipf(universe, 0.99, operations, 1));
+    bench_all("uniform", uniform(universe, operations, 2));
+    bench_all("scan + hot set", scan_hot(operations, 3));
+    bench_all("shifting working set", shifting(operations, 4));
+    return 0;
+}
+
+//------------------------------------------------------------------------------
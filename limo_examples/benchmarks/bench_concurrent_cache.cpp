@@ -0,0 +1,148 @@
+/******************************************************************************
+
+Copyright (c) Dmitri Dolzhenko
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*******************************************************************************/
+
+// Hit throughput of a single mutex guarded limo::Cache against 
+// limo::ConcurrentCache with LRU (exclusive shard lock on hits) and with
+// Clock (shared shard lock on hits) for 1..32 threads. All keys are 
+// preloaded, every lookup is a hit.
+
+//------------------------------------------------------------------------------
+
+// include local:
+#include <limo/cache.hpp>
+#include <limo/concurrent_cache.hpp>
+
+// include std:
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// forward declarations:
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    const int keys = 100000;
+    const int lookups_per_thread = 500000;
+
+    // mops/sec of `threads` workers calling lookup(key) on a hit only workload
+    template <class TLookup>
+    double throughput(int threads, TLookup lookup)
+    {
+        std::atomic<bool> go(false);
+        std::atomic<long> sink(0);
+        std::vector<std::thread> workers;
+
+        for(int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]() {
+                unsigned seed = 2166136261u ^ unsigned(t);
+                long sum = 0;
+                while(!go) 
+                    std::this_thread::yield();
+                for(int i = 0; i < lookups_per_thread; ++i)
+                {
+                    seed = seed * 1664525u + 1013904223u;
+                    sum += lookup(int(seed >> 8) % keys);
+                }
+                sink += sum;
+            });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        go = true;
+        for(auto& x : workers)
+            x.join();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        return threads * double(lookups_per_thread) / elapsed.count() / 1e6;
+    }
+
+} // namespace
+
+int main()
+{
+    using namespace std;
+
+    auto compute = [](const int& key) { return long(key) * 3; };
+
+    limo::Cache<int, long> global(compute, keys);
+    std::mutex global_mutex;
+
+    limo::ConcurrentCache<int, long> sharded(compute, keys);
+    limo::ConcurrentCache<int, long, limo::Clock<int>> clock(compute, keys);
+
+    for(int i = 0; i < keys; ++i)
+    {
+        global[i];
+        sharded.get(i);
+        clock.get(i);
+    }
+
+    cout    << "hit throughput, Mops/sec (" << sharded.shards() << " shards, "
+            << thread::hardware_concurrency() << " hw threads)\n"
+            << setw(8) << "threads" << setw(14) << "mutex+Cache" 
+            << setw(14) << "sharded LRU" << setw(10) << "scaling"
+            << setw(14) << "sharded Clock" << setw(10) << "scaling" << endl;
+
+    double single = 0;
+    double single_shared = 0;
+    for(int threads = 1; threads <= 32; threads *= 2)
+    {
+        const double locked = throughput(threads, [&](int key) {
+            std::lock_guard<std::mutex> lock(global_mutex);
+            return global[key];
+        });
+
+        const double concurrent = throughput(threads, [&](int key) {
+            return sharded.get(key);
+        });
+
+        const double shared = throughput(threads, [&](int key) {
+            return clock.get(key);
+        });
+
+        if (threads == 1)
+        {
+            single = concurrent;
+            single_shared = shared;
+        }
+
+        cout    << setw(8) << threads 
+                << setw(14) << fixed << setprecision(2) << locked
+                << setw(14) << concurrent
+                << setw(9) << concurrent / single << "x"
+                << setw(14) << shared
+                << setw(9) << shared / single_shared << "x" << endl;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
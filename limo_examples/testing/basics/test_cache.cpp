@@ -1,200 +1,1160 @@
-#include <limo/test.hpp>
+#include "limo/test_main.hpp"
+#include <limo/cache.hpp>
+#include <limo/concurrent_cache.hpp>
+#include <limo/tiered_cache.hpp>
+#include <limo_examples/allocation_counter.hpp>
 
-#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <functional>
+#include <future>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
-using namespace std;
-
-template <typename TKey>
-class LRU {
-public:
-    static const bool verbose = true;
-
-    typedef TKey                            key_type;
-    typedef std::list<key_type>             order_impl;
-    typedef typename order_impl::iterator   order_info;
-    typedef LRU<TKey> self_type;
-    
-    order_info promote(order_info x) {
-        m_order.push_front(*x);
-        m_order.erase(x);
-        return m_order.begin();
+//------------------------------------------------------------------------------
+
+template <class TCache>
+std::vector<int> keys_of(const TCache& cache, int max_key)
+{
+    std::vector<int> keys;
+    for(int i = 0; i <= max_key; ++i)
+        if (cache.contains(i))
+            keys.push_back(i);
+    return keys;
+}
+
+// half of the entries live 1ms, then the cache keeps evicting: the 
+// strategy has to stay balanced after erase()
+template <class TCache>
+std::size_t expire_half(TCache& cache)
+{
+    for(int key = 0; key < 16; ++key)
+    {
+        if (key % 2)
+            cache[key];
+        else
+            cache.insert(key, key, std::chrono::milliseconds(1));
     }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    for(int key = 16; key < 64; ++key)
+        cache[key % 40];
+    return cache.statistics().expired;
+}
+
+LTEST (caches) {
+    using namespace std;
+
+    int computed = 0;
+    auto creator = [&computed](int key) { 
+        ++computed;
+        return float(key)/10;
+    };
 
-    order_info push(const key_type& key) {
-        m_order.push_front(key);
-        return m_order.begin();
+    limo::Cache<int, float, limo::LRU<int>> cache(creator, 10);
+
+    for(auto i = 1; i < 11; ++i) {
+        EXPECT_EQ(float(i)/10, cache[i]);
     }
-    
-    TKey pop() {
-        assert(!m_order.empty());
-        if(verbose) {
-            cout << "\tpopping: " << m_order.back() << endl;
+    EXPECT_EQ(10, cache.size());
+    EXPECT_EQ(10, computed);
+
+    EXPECT_EQ(2.4f, cache[24]);
+    EXPECT_EQ(10, cache.size());
+    EXPECT_FALSE(cache.contains(1));
+
+    EXPECT_EQ(0.2f, cache[2]);
+    EXPECT_EQ(11, computed);
+    EXPECT_EQ(0.4f, cache[4]);
+    EXPECT_EQ(11, computed);
+};
+
+LTEST (intrusive_lru) {
+    using namespace std;
+
+    auto creator = [](int key) { return key * 10; };
+
+    limo::Cache<int, int, limo::IntrusiveLRU<int>> cache(creator, 3, limo::IntrusiveLRU<int>(3));
+
+    cache[1]; cache[2]; cache[3];
+    EXPECT_TRUE(keys_of(cache, 9) == vector<int>({1, 2, 3}));
+
+    LTEST(evicts_least_recent, &cache) {
+        cache[1];   // 2 is lru now
+        cache[4];
+        EXPECT_TRUE(keys_of(cache, 9) == vector<int>({1, 3, 4}));
+        
+        cache[5];
+        EXPECT_TRUE(keys_of(cache, 9) == vector<int>({1, 4, 5}));
+        EXPECT_EQ(10, cache[1]);
+    };
+
+    LTEST(hits_allocate_nothing, &cache) {
+        const int keys[] = {1, 4, 5};
+        int sum = 0;
+        for(int key : keys)
+            sum += cache[key];
+
+        const std::size_t before = g_allocations.load();
+        for(int i = 0; i < 1000; ++i)
+            sum += cache[keys[i % 3]];
+        EXPECT_EQ(before, g_allocations.load());
+        EXPECT_GT(sum, 0);
+    };
+
+    LTEST(clear_and_reuse, &cache) {
+        cache.clear();
+        EXPECT_TRUE(cache.empty());
+        for(int i = 0; i < 10; ++i)
+            EXPECT_EQ(i*10, cache[i]);
+        EXPECT_TRUE(keys_of(cache, 9) == vector<int>({7, 8, 9}));
+    };
+
+    LTEST(swap, &cache, creator) {
+        decltype(cache) other(creator, 2);
+        other[42];
+        other.swap(cache);
+        EXPECT_EQ(1, cache.size());
+        cache[43];
+        cache[44];
+        EXPECT_TRUE(keys_of(cache, 50) == vector<int>({43, 44}));
+    };
+};
+
+LTEST (flat_hash_map) {
+    using namespace std;
+
+    limo::FlatHashMap<int, int> map(100);
+    unordered_map<int, int> expected;
+
+    // churn well past the reserved size: tombstones, in-place rehash, growth
+    unsigned seed = 42;
+    for(int i = 0; i < 20000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        const int key = int(seed >> 16) % (i < 10000 ? 150 : 1000);
+        if (seed & 1) {
+            map.insert(make_pair(key, i));
+            expected.insert(make_pair(key, i));
+        }
+        else {
+            EXPECT_EQ(expected.erase(key), map.erase(key));
         }
-        auto key = m_order.back();
-        m_order.pop_back();
-        return key;
     }
 
-    friend ostream& operator<<(ostream& o, const self_type& order) {
-        o << "[";
-        for(auto x : order.m_order) {
-            o << x << ", ";
-        }
-        return o << "]";
+    EXPECT_EQ(expected.size(), map.size());
+    size_t matched = 0;
+    for(const auto& x : map)
+        matched += expected.count(x.first) && expected[x.first] == x.second;
+    EXPECT_EQ(expected.size(), matched);
+
+    LTEST(stable_references, &map) {
+        map.clear();
+        map.reserve(64);
+        const int* first = &map.insert(make_pair(1, 1)).first->second;
+        for(int i = 2; i < 1000; ++i)
+            map.insert(make_pair(i, i));
+        EXPECT_EQ(first, &map.find(1)->second);
+    };
+};
+
+LTEST (flat_storage) {
+    using namespace std;
+
+    auto creator = [](const string& key) { return key + key; };
+
+    limo::Cache<string, string, limo::IntrusiveLRU<string>, limo::FlatStorage> cache(creator, 2);
+
+    EXPECT_EQ("abab", cache["ab"]);
+    EXPECT_EQ("cdcd", cache["cd"]);
+    cache["ab"];
+    EXPECT_EQ("efef", cache["ef"]);
+    EXPECT_TRUE(cache.contains("ab"));
+    EXPECT_FALSE(cache.contains("cd"));
+    EXPECT_EQ(2, cache.size());
+};
+
+LTEST (concurrent_cache) {
+    using namespace std;
+
+    atomic<int> computed(0);
+    auto creator = [&computed](int key) { ++computed; return key * 2; };
+
+    limo::ConcurrentCache<int, int> cache(creator, 64, 8);
+    EXPECT_EQ(8, cache.shards());
+
+    vector<thread> workers;
+    atomic<int> wrong(0);
+    for(int t = 0; t < 8; ++t) {
+        workers.emplace_back([&cache, &wrong, t]() {
+            for(int i = 0; i < 10000; ++i) {
+                const int key = (i * 7 + t) % 48;
+                wrong += cache.get(key) != key * 2;
+            }
+        });
     }
+    for(auto& x : workers)
+        x.join();
+
+    EXPECT_EQ(0, wrong);
+    EXPECT_EQ(80000, cache.statistics().hits + cache.statistics().misses);
+    EXPECT_EQ(size_t(computed) + cache.statistics().coalesced, cache.statistics().misses);
+    EXPECT_LE(cache.size(), 64);
+
+    LTEST(default_shards, creator) {
+        typedef limo::ConcurrentCache<int, int> cache_type;
 
-private:
-    order_impl m_order;
+        cache_type small(creator, 3);
+        EXPECT_EQ(2, small.shards());
+        EXPECT_EQ(1, cache_type(creator, 1).shards());
+        EXPECT_EQ(4, small.get(2));
+
+        const size_t shards = cache_type::default_shards(1 << 20);
+        EXPECT_EQ(0, shards & (shards - 1));
+        EXPECT_EQ(shards, cache_type(creator, 1 << 20).shards());
+    };
 };
 
-template <typename TKey>
-class LFU {
-public:
+LTEST (clock) {
+    using namespace std;
+
+    auto creator = [](int key) { return key; };
 
+    limo::Cache<int, int, limo::Clock<int>> cache(creator, 3);
+    cache[1]; cache[2]; cache[3];
 
-    typedef TKey                    key_type;
-    typedef std::list<key_type>     bucket_type;
-    
-    std::list<bucket_type>          m_buckets;
-    
-    struct order_info {
-        std::list<bucket_type>  bucket;
-        typename bucket_type::iterator   order;
+    LTEST(second_chance, &cache) {
+        cache[1];   // 1 referenced, hand at 1
+        cache[4];   // 1 gets second chance, 2 evicted
+        EXPECT_TRUE(keys_of(cache, 9) == vector<int>({1, 3, 4}));
+        cache[5];   // 3 evicted, bit of 1 was cleared by the sweep
+        cache[6];   // so 1 goes now
+        EXPECT_TRUE(keys_of(cache, 9) == vector<int>({4, 5, 6}));
     };
-    
-    order_info promote(order_info x) {
-        auto next_bucket = x.bucket;
-        ++next_bucket;
-        if (next_bucket == m_buckets.end()) {
-            buckets.push_back(Bucket());
-            next_bucket = buckets.end();
-            -- next_bucket;
-        }
 
-        next_bucket->push_front(*x.order);
-        x.bucket->erase(x.order);
+    LTEST(find_touches, &cache) {
+        EXPECT_TRUE(cache.find(1) == nullptr);
+        EXPECT_EQ(4, *cache.find(4));
+        cache[7];   // 4 survives, 5 evicted
+        EXPECT_TRUE(keys_of(cache, 9) == vector<int>({4, 6, 7}));
+    };
 
-        return order_info(next_bucket, next_bucket->begin());
-    }
+    LTEST(concurrent_shared_hits) {
+        atomic<int> computed(0);
+        limo::ConcurrentCache<int, int, limo::Clock<int>> cache(
+            [&computed](int key) { ++computed; return key + 1; }, 32, 4);
+        EXPECT_TRUE(cache.shared_hit_path);
 
-    order_info push(const key_type& key) {
-        m_order.push_front(key);
-        return m_order.begin();
-    }
-    
-    TKey pop() {
-        if(!m_buckets.empty() && !m_buckets.front.empty()) {
-            m_buckets.front().pop_back();
+        vector<thread> workers;
+        atomic<int> wrong(0);
+        for(int t = 0; t < 4; ++t) {
+            workers.emplace_back([&cache, &wrong, t]() {
+                for(int i = 0; i < 10000; ++i) {
+                    const int key = (i + t) % (i < 5000 ? 16 : 40);
+                    wrong += cache.get(key) != key + 1;
+                }
+            });
         }
-    }
+        for(auto& x : workers)
+            x.join();
 
+        EXPECT_EQ(0, wrong);
+        EXPECT_EQ(40000, cache.statistics().hits + cache.statistics().misses);
+        EXPECT_EQ(size_t(computed) + cache.statistics().coalesced, cache.statistics().misses);
+    };
 };
 
+LTEST (lfu) {
+    using namespace std;
 
+    auto creator = [](int key) { return key; };
 
-template <typename TKey, typename TValue, 
-    template <class> class TCacheStrategy = LRU>
-class Cache {
-public:
-    typedef std::function<TValue(const TKey&)> computor_type;
-    typedef std::size_t size_type;
-    typedef TKey key_type;
+    limo::Cache<int, int, limo::LFU<int>> cache(creator, 3);
+    cache[1]; cache[1]; cache[1];
+    cache[2]; cache[2];
+    cache[3];
 
-    typedef Cache<TKey, TValue, TCacheStrategy> self_type;
-    
-public:
-    Cache(computor_type computor, size_type capacity=1000)
-    : m_capacity(capacity)
-    , m_compute(computor)
-    {
+    cache[4];   // 3 is the least frequent
+    EXPECT_TRUE(keys_of(cache, 9) == vector<int>({1, 2, 4}));
 
+    cache[4]; cache[4];   // 4 is at 3 now, 2 at 2
+    cache[5];
+    EXPECT_TRUE(keys_of(cache, 9) == vector<int>({1, 4, 5}));
+
+    cache[6];   // same frequency: least recent of them goes
+    EXPECT_TRUE(keys_of(cache, 9) == vector<int>({1, 4, 6}));
+};
+
+// warmed up hot set re-read between runs of one-off keys, the reuse 
+// distance of the hot keys is above the capacity of 100
+template <class TCache>
+double scan_polluted_hit_ratio(TCache& cache)
+{
+    for(int warmup = 0; warmup < 2; ++warmup)
+        for(int hot = 0; hot < 50; ++hot)
+            cache[hot];
+
+    int scan = 1000;
+    for(int round = 0; round < 50; ++round) {
+        for(int i = 0; i < 75; ++i)
+            cache[scan++];
+        for(int hot = 0; hot < 50; ++hot)
+            cache[hot];
     }
+    const auto stat = cache.statistics();
+    return double(stat.hits) / (stat.hits + stat.misses);
+}
 
-public: // state
+LTEST (wtinylfu) {
+    using namespace std;
 
-    size_type size() const          { return m_cache.size(); }
-    size_type capacity() const      { return m_capacity; }
+    auto hit_ratio = [](auto& cache) { return scan_polluted_hit_ratio(cache); };
 
-    bool empty() const              { return size() == 0; }
+    auto creator = [](int key) { return key; };
 
+    limo::Cache<int, int, limo::LRU<int>> lru(creator, 100);
+    limo::Cache<int, int, limo::WTinyLFU<int>> tiny(creator, 100, limo::WTinyLFU<int>(100));
 
-    TValue& get(const key_type& key) {
-        
-        auto x = m_cache.find(key);
-        const bool hit = m_cache.end() != x;
-        if(hit) {
-            std::cout << "<hit: " << key << ">: ";
+    EXPECT_LT(hit_ratio(lru), 0.01);
+    EXPECT_GT(hit_ratio(tiny), 0.35);
 
-            x->second.info = m_order.promote(x->second.info);
-        }
-        else {
-            std::cout << "<miss: " << key << ">: ";
-            assert(size() <= capacity());
+    LTEST(sketch) {
+        limo::FrequencySketch<int> sketch(64);
+        for(int i = 0; i < 5; ++i)
+            sketch.increment(42);
+        sketch.increment(7);
+        EXPECT_EQ(5, sketch.estimate(42));
+        EXPECT_EQ(1, sketch.estimate(7));
+        EXPECT_EQ(0, sketch.estimate(8));
+    };
+};
+
+LTEST (scan_resistance) {
+    using namespace std;
+
+    auto creator = [](int key) { return key; };
+
+    LTEST(arc, creator) {
+        limo::Cache<int, int, limo::ARC<int>> cache(creator, 100, limo::ARC<int>(100));
+        EXPECT_GT(scan_polluted_hit_ratio(cache), 0.35);
+        EXPECT_EQ(100, cache.size());
+    };
+
+    LTEST(arc_ghost_hit, creator) {
+        limo::Cache<int, int, limo::ARC<int>> cache(creator, 2, limo::ARC<int>(2));
+        cache[1]; cache[2];
+        cache[1];   // T1: 2, T2: 1
+        cache[3];   // 2 goes to B1
+        EXPECT_EQ(0, cache.strategy().target());
+        cache[2];   // B1 hit grows T1 target, 1 goes to B2
+        EXPECT_EQ(1, cache.strategy().target());
+        EXPECT_TRUE(keys_of(cache, 9) == vector<int>({2, 3}));
+        cache[1];   // B2 hit shrinks it back
+        EXPECT_EQ(0, cache.strategy().target());
+    };
 
-            if(size() == capacity()) {
-                m_cache.erase(m_order.pop());
+    LTEST(arc_adapts_once_per_admission) {
+        limo::ARC<int> arc(4);
+        const int keys[] = {1, 2, 3, 4, 5};
+        arc.promote(arc.push(keys[0]));
+        for(int i = 1; i < 4; ++i)
+            arc.push(keys[i]);
+        arc.pop(keys[4]);   // 2 goes to B1
+        arc.push(keys[4]);
+
+        arc.pop(keys[1]);   // B1 hit, as a weighted cache makes room
+        arc.pop(keys[1]);
+        arc.pop(keys[1]);
+        EXPECT_EQ(1, arc.target());
+        arc.push(keys[1]);
+        EXPECT_EQ(1, arc.target());
+    };
+
+    LTEST(two_q, creator) {
+        limo::Cache<int, int, limo::TwoQ<int>> cache(creator, 100, limo::TwoQ<int>(100));
+        EXPECT_GT(scan_polluted_hit_ratio(cache), 0.35);
+        EXPECT_EQ(100, cache.size());
+    };
+};
+
+LTEST (single_flight) {
+    using namespace std;
+
+    atomic<int> computed(0);
+    auto slow = [&computed](int key) { 
+        ++computed;
+        this_thread::sleep_for(chrono::milliseconds(50));
+        if (key < 0)
+            throw invalid_argument("negative key");
+        return key * 2; 
+    };
+
+    limo::ConcurrentCache<int, int> cache(slow, 16, 4);
+
+    vector<thread> workers;
+    atomic<int> wrong(0);
+    atomic<int> failed(0);
+    for(int t = 0; t < 8; ++t) {
+        workers.emplace_back([&]() {
+            wrong += cache.get(21) != 42;
+            try { 
+                cache.get(-1); 
             }
-            
-            x = m_cache.insert(std::make_pair(key, Data(m_compute(key), m_order.push(key)))).first;
-        }
+            catch(const invalid_argument&) {
+                ++failed;
+            }
+        });
+    }
+    for(auto& x : workers)
+        x.join();
+
+    EXPECT_EQ(0, wrong);
+    EXPECT_EQ(8, failed);
+
+    // one computation per distinct miss, unless a thread came late
+    const auto stat = cache.statistics();
+    EXPECT_EQ(size_t(computed) + stat.coalesced, stat.misses);
+    EXPECT_EQ(16, stat.hits + stat.misses);
+    EXPECT_GE(stat.coalesced, 1);
+    EXPECT_FALSE(cache.contains(-1));
+};
+
+LTEST (get_async) {
+    using namespace std;
+
+    atomic<int> computed(0);
+    auto compute = [&computed](int key) { ++computed; return key * 3; };
+
+    // tasks are queued and run only when the test says so
+    vector<function<void()>> queue;
+    auto executor = [&queue](function<void()> task) { queue.push_back(task); };
+
+    limo::ConcurrentCache<int, int> cache(compute, executor, 16, 2);
+
+    auto first = cache.get_async(1);
+    auto again = cache.get_async(1);
+    auto second = cache.get_async(2);
+
+    EXPECT_EQ(2, queue.size());
+    EXPECT_EQ(0, computed);
+    EXPECT_EQ(2, cache.collect());
+
+    for(auto& task : queue)
+        task();
+    EXPECT_EQ(3, first.get());
+    EXPECT_EQ(3, again.get());
+    EXPECT_EQ(6, second.get());
+
+    EXPECT_EQ(0, cache.collect());
+    EXPECT_TRUE(cache.contains(1) && cache.contains(2));
+
+    auto hit = cache.get_async(2);
+    EXPECT_EQ(6, hit.get());
+    EXPECT_EQ(2, computed);
+    EXPECT_EQ(1, cache.statistics().coalesced);
+
+    LTEST(async_computor) {
+        limo::ConcurrentCache<int, int> cache(
+            [](int key) { return async(launch::async, [key]() { return key + 1; }).share(); }, 
+            16, 2);
+
+        EXPECT_EQ(8, cache.get_async(7).get());
+        EXPECT_EQ(8, cache.get(7));     // in flight entry is harvested
+        EXPECT_EQ(8, cache.get(7));
+        EXPECT_EQ(1, cache.statistics().hits);
+    };
+
+    // the computor runs on the pool, the shard is not locked for it
+    LTEST(default_executor) {
+        atomic<bool> release(false);
+        limo::ConcurrentCache<int, int>* self = nullptr;
+        limo::ConcurrentCache<int, int> cache([&release, &self](int key) { 
+            self->contains(key);
+            while(!release)
+                this_thread::yield();
+            return key * 5; 
+        }, 16, 2);
+        self = &cache;
+
+        auto pending = cache.get_async(3);
+        EXPECT_TRUE(pending.wait_for(chrono::seconds(0)) != future_status::ready);
+        EXPECT_FALSE(cache.contains(3));
+        EXPECT_EQ(1, cache.collect());
+
+        release = true;
+        EXPECT_EQ(15, pending.get());
+        EXPECT_EQ(15, cache.get(3));
+        EXPECT_EQ(0, cache.collect());
+    };
+
+    // finished flights reach the cache with the next access of the shard
+    LTEST(fire_and_forget) {
+        vector<function<void()>> queue;
+        limo::ConcurrentCache<int, int> cache(
+            [](int key) { return key * 2; }, 
+            [&queue](function<void()> task) { queue.push_back(task); }, 
+            16, 1);
+        cache.get_async(1);
+        cache.get_async(2);
+        for(auto& task : queue)
+            task();
+
+        EXPECT_FALSE(cache.contains(1));
+        EXPECT_EQ(6, cache.get(3));
+        EXPECT_TRUE(cache.contains(1) && cache.contains(2));
+        EXPECT_EQ(0, cache.collect());
+    };
+
+    // futures of an async computor are polled as their count grows
+    LTEST(fire_and_forget_futures) {
+        limo::ConcurrentCache<int, int> cache([](int key) { 
+            promise<int> ready;
+            ready.set_value(key);
+            return ready.get_future().share();
+        }, 100, 1);
+        for(int key = 0; key < 40; ++key)
+            cache.get_async(key);
+        EXPECT_TRUE(cache.contains(0) && cache.contains(15));
+        EXPECT_GT(cache.size(), 16);
+        EXPECT_EQ(0, cache.collect());
+        EXPECT_EQ(40, cache.size());
+    };
+
+    // a miss of the key while it is launched waits for that launch
+    LTEST(coalesced_while_launching) {
+        atomic<int> launched(0);
+        limo::ConcurrentCache<int, int> cache([&launched](int key) { 
+            ++launched;
+            this_thread::sleep_for(chrono::milliseconds(20));
+            promise<int> ready;
+            ready.set_value(key - 1);
+            return ready.get_future().share();
+        }, 16, 2);
+
+        auto other = async(launch::async, [&cache]() { return cache.get_async(5).get(); });
+        this_thread::sleep_for(chrono::milliseconds(5));
+        EXPECT_EQ(4, cache.get_async(5).get());
+        EXPECT_EQ(4, other.get());
+        EXPECT_EQ(1, launched);
+    };
+};
+
+// a key without std::hash
+struct Point
+{
+    int x, y;
+    bool operator==(const Point& other) const { return x == other.x && y == other.y; }
+};
+
+struct PointHash
+{
+    std::size_t operator()(const Point& p) const { return std::hash<int>()(p.x * 31 + p.y); }
+};
+
+LTEST (get_many) {
+    using namespace std;
+
+    int single = 0;
+    int bulk_calls = 0;
+    size_t bulk_keys = 0;
+    auto compute = [&single](int key) { ++single; return key * 10; };
+    auto bulk = [&bulk_calls, &bulk_keys](const vector<int>& keys) {
+        ++bulk_calls;
+        bulk_keys += keys.size();
+        vector<int> values;
+        for(auto key : keys)
+            values.push_back(key * 10);
+        return values;
+    };
+
+    limo::Cache<int, int, limo::LRU<int>, limo::FlatStorage> cache(compute, bulk, 8);
+    cache[1]; cache[2];
+    EXPECT_EQ(2, single);
+
+    const vector<int> keys = {1, 3, 2, 3, 4};
+    vector<int> values;
+    cache.get_many(keys.begin(), keys.end(), back_inserter(values));
+
+    EXPECT_TRUE(values == vector<int>({10, 30, 20, 30, 40}));
+    EXPECT_EQ(2, single);
+    EXPECT_EQ(1, bulk_calls);
+    EXPECT_EQ(2, bulk_keys);        // 3 only once
+    EXPECT_EQ(4, cache.size());
+
+    LTEST(larger_than_capacity, &cache, &single, &bulk_calls) {
+        vector<int> keys;
+        for(int i = 0; i < 20; ++i)
+            keys.push_back(i % 10);
+
+        vector<int> values(keys.size());
+        cache.get_many(keys.begin(), keys.end(), values.begin());
+        for(size_t i = 0; i < keys.size(); ++i)
+            EXPECT_EQ(keys[i] * 10, values[i]);
+        EXPECT_EQ(8, cache.size());
+        // 1..4 were hits before the batch, the batch evicts them before
+        // their second round: computed one by one
+        EXPECT_EQ(6, single);
+        EXPECT_EQ(2, bulk_calls);
+    };
+
+    LTEST(custom_hash) {
+        limo::Cache<Point, int, limo::LRU<Point>, limo::NodeStorage, PointHash> points(
+            [](const Point& p) { return p.x * p.y; }, 4);
+        const vector<Point> keys = {{1, 2}, {3, 4}, {1, 2}};
+        vector<int> values(keys.size());
+        points.get_many(keys.begin(), keys.end(), values.begin());
+        EXPECT_TRUE(values == vector<int>({2, 12, 2}));
+        EXPECT_EQ(2, points.size());
+    };
+};
+
+LTEST (weighted) {
+    using namespace std;
+
+    auto creator = [](int key) { return string(size_t(key), '*'); };
+
+    limo::Cache<int, string> cache(creator, 10);
+    cache.set_weigher([](int, const string& value) { return value.size(); });
+
+    cache[3]; cache[4]; cache[2];
+    EXPECT_EQ(3, cache.size());
+    EXPECT_EQ(9, cache.weight());
+
+    LTEST(evicts_until_fits, &cache) {
+        cache[5];   // 3 and 4 have to go
+        EXPECT_TRUE(keys_of(cache, 9) == vector<int>({2, 5}));
+        EXPECT_EQ(7, cache.weight());
+    };
+
+    LTEST(heavier_than_capacity, &cache) {
+        cache[12];
+        EXPECT_EQ(1, cache.size());
+        EXPECT_EQ(12, cache.weight());
+        cache[1];
+        EXPECT_TRUE(keys_of(cache, 20) == vector<int>({1}));
+    };
+
+    LTEST(replace_reweighs, &cache) {
+        cache.insert(1, "***");
+        EXPECT_EQ(3, cache.weight());
+        cache.clear();
+        EXPECT_EQ(0, cache.weight());
+    };
+
+    LTEST(replace_heavier_evicts_others, creator) {
+        limo::Cache<int, string> lru(creator, 10);
+        lru.set_weigher([](int, const string& value) { return value.size(); });
+        lru[3]; lru[4]; lru[2];
+        lru.insert(3, "*******");
+        EXPECT_TRUE(keys_of(lru, 9) == vector<int>({2, 3}));
+        EXPECT_EQ(9, lru.weight());
+
+        // 3 is the least frequent, still the others go
+        limo::Cache<int, string, limo::LFU<int>> lfu(creator, 10);
+        lfu.set_weigher([](int, const string& value) { return value.size(); });
+        lfu[3]; lfu[4]; lfu[4]; lfu[2]; lfu[2];
+        lfu.insert(3, "********");
+        EXPECT_TRUE(lfu.contains(3));
+        EXPECT_LE(lfu.weight(), 10);
+        EXPECT_EQ(8, lfu[3].size());
+
+        lfu.insert(3, string(20, '*'));
+        EXPECT_TRUE(keys_of(lfu, 9) == vector<int>({3}));
+        EXPECT_EQ(20, lfu.weight());
+    };
+
+    // a byte budget does not preallocate a slot per byte
+    LTEST(flat_storage_byte_budget, creator) {
+        limo::Cache<int, string, limo::LRU<int>, limo::FlatStorage> bytes(creator, size_t(1) << 40);
+        bytes.set_weigher([](int, const string& value) { return value.size(); }, 16);
+        for(int key = 1; key < 100; ++key)
+            bytes[key];
+        EXPECT_EQ(99, bytes.size());
+        EXPECT_EQ(99 * 50, bytes.weight());
+    };
+};
+
+LTEST (greedy_dual_size) {
+    using namespace std;
+
+    auto creator = [](int key) { return key; };
 
-        return x->second.value;
+    limo::Cache<int, int, limo::GreedyDualSize<int>> cache(
+        creator, 3, limo::GreedyDualSize<int>(3));
+
+    LTEST(keeps_expensive, &cache) {
+        cache.insert(1, 1, 10.0);
+        cache.insert(2, 2, 1.0);
+        for(int key = 3; key < 10; ++key)
+            cache.insert(key, key, 2.0);
+        // cheap entries push each other out while L is below 1's priority
+        EXPECT_TRUE(cache.contains(1));
+        EXPECT_FALSE(cache.contains(2));
+        EXPECT_GE(cache.strategy().inflation(), 2.0);
+    };
+
+    LTEST(hits_restore_credit, &cache) {
+        cache.clear();
+        cache.insert(1, 1, 4.0);
+        cache.insert(2, 2, 4.0);
+        cache.insert(3, 3, 1.0);
+        cache.insert(4, 4, 1.0);    // 3 evicted, L = 1
+        cache.insert(5, 5, 1.0);    // 4 evicted, L = 2
+        cache[1];                   // priority of 1 is 6 now
+        cache.insert(6, 6, 4.0);    // 5 evicted, L = 3
+        cache.insert(7, 7, 4.0);    // 2 evicted, L = 4
+        EXPECT_TRUE(keys_of(cache, 9) == vector<int>({1, 6, 7}));
+    };
+
+    LTEST(reinsert_takes_new_cost, &cache) {
+        cache.clear();
+        cache.insert(1, 1, 1.0);
+        cache.insert(2, 2, 2.0);
+        cache.insert(3, 3, 2.0);
+        cache.insert(1, 1, 10.0);   // recomputing 1 got expensive
+        cache.insert(4, 4, 2.0);
+        EXPECT_TRUE(cache.contains(1));
+        EXPECT_EQ(3, cache.size());
+
+        cache.insert(1, 1, 0.5);    // and cheap again: goes after 3
+        cache.insert(5, 5, 2.0);
+        cache.insert(6, 6, 2.0);
+        EXPECT_TRUE(keys_of(cache, 9) == vector<int>({4, 5, 6}));
+    };
+
+    LTEST(credit_per_weight, creator) {
+        limo::Cache<int, int, limo::GreedyDualSize<int>> cache(creator, 4, limo::GreedyDualSize<int>(4));
+        cache.set_weigher([](int key, int) { return key < 10 ? 1 : 3; });
+        cache.insert(1, 1, 2.0);    // credit 2
+        cache.insert(10, 10, 3.0);  // credit 1: heavy and not expensive enough
+        cache.insert(2, 2, 2.0);
+        EXPECT_TRUE(keys_of(cache, 20) == vector<int>({1, 2}));
+    };
+};
+
+LTEST (timing_wheel) {
+    using namespace std;
+    using chrono::milliseconds;
+    typedef limo::TimingWheel<int> wheel_type;
+
+    wheel_type wheel(milliseconds(1));
+    const auto start = wheel_type::clock_type::now();
+
+    // deadlines on every level and past the horizon of 4.6 hours
+    vector<int> keys;
+    for(int i = 0; i < 400; ++i)
+        keys.push_back(i * i * 157 % 20000000);
+    for(const auto& key : keys)
+        wheel.schedule(key, start + milliseconds(key));
+
+    vector<bool> done(keys.size());
+    int early = 0;
+    int late = 0;
+    for(int t = 0; !wheel.empty(); t += 997)
+    {
+        const auto now = start + milliseconds(t);
+        wheel.advance(now, [&](const int& key) {
+            early += start + milliseconds(key) > now;
+            done[&key - keys.data()] = true;
+        });
+        for(size_t i = 0; i < keys.size(); ++i)
+            late += !done[i] && keys[i] + 1 < t;
     }
+    EXPECT_EQ(0, early);
+    EXPECT_EQ(0, late);
+
+    // idle periods are skipped at once, entries scheduled and canceled 
+    // on the way still expire within their tick
+    LTEST(jumps, start) {
+        wheel_type wheel(milliseconds(1));
+        mt19937 random(7);
+        vector<int> keys(2000);
+        vector<wheel_type::index_type> timers(keys.size(), wheel_type::index_type(wheel_type::npos));
+        vector<long long> deadlines(keys.size());
+        int early = 0;
+        int late = 0;
 
-    friend ostream& operator<<(ostream& o, const self_type& cache) {
-        o <<  "cache capacity=" << cache.capacity() << ", size=" << cache.size() << endl;
-        o << "\telements: [";
-        for(const auto& x : cache.m_cache) {
-            o << "(" << x.first << "," << x.second.value << "), ";
+        long long now = 0;
+        for(int round = 0; round < 200; ++round)
+        {
+            for(int i = 0; i < 10; ++i)
+            {
+                const size_t x = random() % keys.size();
+                if (timers[x] != wheel_type::npos)
+                {
+                    wheel.cancel(timers[x]);
+                    timers[x] = wheel_type::npos;
+                    continue;
+                }
+                keys[x] = int(x);
+                deadlines[x] = now + (long long)(random() % 3) * (long long)(random() % 20000000);
+                timers[x] = wheel.schedule(keys[x], start + milliseconds(deadlines[x]));
+            }
+
+            now += round % 10 ? random() % 100 : random() % 10000000;
+            wheel.advance(start + milliseconds(now), [&](const int& key) {
+                early += deadlines[&key - keys.data()] > now;
+                timers[&key - keys.data()] = wheel_type::npos;
+            });
+            for(size_t x = 0; x < keys.size(); ++x)
+                late += timers[x] != wheel_type::npos && deadlines[x] + 1 < now;
         }
-        o   << endl 
-            << "\tstrategy: " << cache.m_order << endl;
-        return o;
-    }
+        EXPECT_EQ(0, early);
+        EXPECT_EQ(0, late);
+    };
+
+    LTEST(cancel) {
+        wheel_type wheel;
+        const int key = 1;
+        const auto x = wheel.schedule(key, wheel_type::clock_type::now());
+        wheel.cancel(x);
+        EXPECT_TRUE(wheel.empty());
+        int expired = 0;
+        wheel.advance(wheel_type::clock_type::now() + chrono::hours(1), [&expired](const int&) { ++expired; });
+        EXPECT_EQ(0, expired);
+    };
+};
+
+LTEST (ttl) {
+    using namespace std;
+    using chrono::milliseconds;
+
+    int computed = 0;
+    auto creator = [&computed](int key) { ++computed; return key; };
+
+    limo::Cache<int, int> cache(creator, 32);
+    cache.set_ttl(chrono::hours(1));
+    cache[1]; cache[2];
+    cache.insert(3, 30, milliseconds(1));
+    this_thread::sleep_for(milliseconds(5));
+
+    LTEST(expired_is_miss, &cache, &computed) {
+        EXPECT_TRUE(keys_of(cache, 9) == vector<int>({1, 2}));
+        EXPECT_EQ(3, cache[3]);
+        EXPECT_EQ(3, computed);
+        EXPECT_EQ(1, cache.statistics().expired);
+        EXPECT_EQ(3, cache.statistics().misses);
+        EXPECT_EQ(1, cache[1]);
+        EXPECT_EQ(1, cache.statistics().hits);
+    };
 
-private:
+    LTEST(reaped_without_lookup, &cache) {
+        for(int key = 10; key < 30; ++key)
+            cache.insert(key, key, milliseconds(1));
+        EXPECT_EQ(23, cache.size());
+        this_thread::sleep_for(milliseconds(5));
+        cache[1];
+        EXPECT_EQ(3, cache.size());
+        EXPECT_EQ(21, cache.statistics().expired);
+    };
 
-    typedef typename TCacheStrategy<TKey>::order_info order_info;
+    LTEST(replace_reschedules, &cache) {
+        cache.insert(5, 5, milliseconds(1));
+        cache.insert(5, 50);
+        this_thread::sleep_for(milliseconds(5));
+        EXPECT_TRUE(cache.contains(5));
+    };
 
-    struct Data {
-        Data(const TValue& v, const order_info& inf): value(v), info(inf) {}
-        TValue      value;
-        order_info  info;
+    LTEST(copy_keeps_deadlines, &cache) {
+        cache.insert(6, 6, milliseconds(1));
+        auto copy = cache;
+        cache.clear();
+        EXPECT_TRUE(copy.contains(1));
+        this_thread::sleep_for(milliseconds(5));
+        EXPECT_FALSE(copy.contains(6));
+        copy[1];
+        EXPECT_FALSE(copy.contains(6));
+        EXPECT_TRUE(copy.contains(5));
     };
 
-    typedef std::unordered_map<TKey, Data>  cache_map;
+    LTEST(strategies_erase) {
+        auto id = [](int key) { return key; };
+        limo::Cache<int, int, limo::IntrusiveLRU<int>> intrusive(id, 16, limo::IntrusiveLRU<int>(16));
+        limo::Cache<int, int, limo::Clock<int>> clock(id, 16, limo::Clock<int>(16));
+        limo::Cache<int, int, limo::LFU<int>> lfu(id, 16);
+        limo::Cache<int, int, limo::WTinyLFU<int>> tiny(id, 16, limo::WTinyLFU<int>(16));
+        limo::Cache<int, int, limo::ARC<int>> arc(id, 16, limo::ARC<int>(16));
+        limo::Cache<int, int, limo::TwoQ<int>> two_q(id, 16, limo::TwoQ<int>(16));
+        limo::Cache<int, int, limo::GreedyDualSize<int>> gds(id, 16, limo::GreedyDualSize<int>(16));
 
-    cache_map m_cache;
-    TCacheStrategy<TKey> m_order;
-    size_type m_capacity;
-    computor_type m_compute;
+        EXPECT_EQ(8, expire_half(intrusive));
+        EXPECT_EQ(8, expire_half(clock));
+        EXPECT_EQ(8, expire_half(lfu));
+        EXPECT_EQ(8, expire_half(tiny));
+        EXPECT_EQ(8, expire_half(arc));
+        EXPECT_EQ(8, expire_half(two_q));
+        EXPECT_EQ(8, expire_half(gds));
+        EXPECT_EQ(16, arc.size());
+        EXPECT_EQ(16, gds.size());
+    };
 };
 
+LTEST (statistics) {
+    using namespace std;
 
+    auto creator = [](int key) { 
+        this_thread::sleep_for(chrono::microseconds(200));
+        return key; 
+    };
 
-LTEST (caches) {
+    limo::Cache<int, int> cache(creator, 4);
+    EXPECT_EQ(0.f, cache.hit_ratio());
+
+    for(int key = 0; key < 6; ++key)
+        cache[key];
+    cache[5]; cache[4];
+    cache.insert(4, 40);
+
+    const auto x = cache.statistics();
+    EXPECT_EQ(2, x.hits);
+    EXPECT_EQ(6, x.misses);
+    EXPECT_EQ(6, x.loads);
+    EXPECT_EQ(6, x.inserts);
+    EXPECT_EQ(2, x.evictions);
+    EXPECT_EQ(4, x.size());
+    EXPECT_EQ(4, x.weight);
+    EXPECT_EQ(0.25f, cache.hit_ratio());
+    EXPECT_GE(x.average_load_time(), 200e-6);
+    EXPECT_GE(x.load_latency_percentile(0.5), 200e-6);
+    EXPECT_LE(x.load_latency_percentile(0.5), x.load_latency_percentile(1));
+    EXPECT_GT(x.insert_rate(), 0);
+
+    LTEST(interval, &cache, x) {
+        cache[0]; cache[1];
+        const auto y = cache.statistics().since(x);
+        EXPECT_EQ(0, y.hits);
+        EXPECT_EQ(2, y.misses);
+        EXPECT_EQ(2, y.evictions);
+        EXPECT_EQ(4, y.weight);
+    };
+
+    LTEST(clear_keeps_nothing, &cache) {
+        cache.clear();
+        const auto y = cache.statistics();
+        EXPECT_EQ(0, y.loads + y.inserts + y.weight);
+    };
+
+    LTEST(scraped_concurrently) {
+        limo::Cache<int, int> cache([](int key) { return key; }, 64);
+        atomic<bool> done(false);
+        size_t last = 0;
+        bool monotonic = true;
+        thread scraper([&]() {
+            while(!done)
+            {
+                const auto s = cache.statistics();
+                monotonic = monotonic && s.hits + s.misses >= last;
+                last = s.hits + s.misses;
+            }
+        });
+        for(int i = 0; i < 100000; ++i)
+            cache[i % 100];
+        done = true;
+        scraper.join();
+        EXPECT_TRUE(monotonic);
+        EXPECT_EQ(100000, cache.statistics().hits + cache.statistics().misses);
+    };
+
+    LTEST(shards_merge) {
+        limo::ConcurrentCache<int, int, limo::Clock<int>> cache([](int key) { return key; }, 32, 4);
+        for(int i = 0; i < 64; ++i)
+            cache.get(i % 16);
+        const auto s = cache.statistics();
+        EXPECT_EQ(48, s.hits);
+        EXPECT_EQ(16, s.loads);
+        EXPECT_EQ(16, s.weight);
+    };
+};
+
+LTEST (snapshot) {
     using namespace std;
 
-    EXPECT(2*2 == 5);
+    const string path = "limo_test_cache.snapshot";
+    auto creator = [](int key) { return key * 10; };
 
-    auto creator = [](int key) { 
-        return float(key)/10;
+    limo::Cache<int, int> cache(creator, 4);
+    cache[1]; cache[2]; cache[3]; cache[4];
+    cache[1];                                   // order: 2 3 4 1
+    EXPECT_TRUE(cache.save(path));
+
+    LTEST(keeps_order, &cache, path, creator) {
+        limo::Cache<int, int> warm(creator, 4);
+        EXPECT_TRUE(warm.load(path));
+        EXPECT_TRUE(keys_of(warm, 9) == vector<int>({1, 2, 3, 4}));
+        EXPECT_EQ(10, *warm.lookup(1));
+        warm[5]; warm[6];                       // 2 and 3 go, as in cache
+        cache[5]; cache[6];
+        EXPECT_TRUE(keys_of(warm, 9) == keys_of(cache, 9));
+        EXPECT_EQ(6, warm.statistics().inserts);
+    };
+
+    LTEST(smaller_capacity, path, creator) {
+        limo::Cache<int, int, limo::IntrusiveLRU<int>> warm(creator, 2, limo::IntrusiveLRU<int>(2));
+        EXPECT_TRUE(warm.load(path));
+        EXPECT_TRUE(keys_of(warm, 9) == vector<int>({1, 4}));
     };
 
-    Cache<int, float, LRU> cache(creator, 10);
+    LTEST(strings, path) {
+        auto echo = [](const string& key) { return key + key; };
+        limo::Cache<string, string, limo::ARC<string>> cache(echo, 8, limo::ARC<string>(8));
+        cache["a"]; cache["bc"]; cache[string(1000, 'x')];
+        EXPECT_TRUE(cache.save(path));
 
-    for(auto i = 1; i < 11; ++i) {
-        cout << cache.get(i) << endl;
-    }
-    
-    cout << cache;
+        limo::Cache<string, string, limo::ARC<string>> warm(echo, 8, limo::ARC<string>(8));
+        EXPECT_TRUE(warm.load(path));
+        EXPECT_EQ(3, warm.size());
+        EXPECT_TRUE(*warm.lookup("bc") == "bcbc");
+        EXPECT_EQ(2000, warm.lookup(string(1000, 'x'))->size());
+    };
+
+    LTEST(rejects, path, creator) {
+        limo::Cache<int, int> warm(creator, 4);
+        warm[7];
+        EXPECT_FALSE(warm.load("no_such_limo_snapshot"));
+        EXPECT_TRUE(warm.empty());
+
+        limo::Cache<int, double> other([](int key) { return double(key); }, 4);
+        EXPECT_FALSE(other.load(path));     // strings, see above
+
+        {
+            ofstream truncated(path, ios::binary | ios::trunc);
+            truncated << "limocach";
+        }
+        EXPECT_FALSE(warm.load(path));
+        remove(path.c_str());
+    };
+};
+
+LTEST (tiered) {
+    using namespace std;
 
-    cout << cache.get(24) << endl;
+    int computed = 0;
+    auto creator = [&computed](int key) { ++computed; return to_string(key); };
 
-    cout << cache;
-    cout << cache.get(1) << endl;
-    cout << cache.get(2) << endl;
-    cout << cache.get(4) << endl;
-    cout << cache;
-};
\ No newline at end of file
+    limo::TieredCache<int, string> cache(creator, 4, "limo_test_tier.bin", 1 << 20);
+    EXPECT_TRUE(cache.disk().is_open());
+
+    for(int key = 0; key < 10; ++key)
+        cache[key];
+    EXPECT_EQ(10, computed);
+    EXPECT_EQ(4, cache.memory().size());
+    EXPECT_EQ(6, cache.disk().size());
+
+    LTEST(promotes, &cache, &computed) {
+        EXPECT_TRUE(cache[0] == "0");
+        EXPECT_TRUE(cache[1] == "1");
+        EXPECT_EQ(10, computed);
+        EXPECT_EQ(2, cache.promotions());
+        EXPECT_FALSE(cache.disk().contains(0));
+        EXPECT_TRUE(cache.disk().contains(6));   // demoted meanwhile
+        EXPECT_EQ(10, cache.size());
+    };
+
+    LTEST(insert_drops_disk_copy, &cache, &computed) {
+        cache.insert(2, "two");
+        EXPECT_FALSE(cache.disk().contains(2));
+        EXPECT_TRUE(cache[2] == "two");
+    };
+
+    LTEST(disk_ring) {
+        // records of 40 bytes, one per 64 byte region
+        limo::DiskStore<int, string> store("limo_test_disk.bin", 4 * 64, 64);
+        for(int key = 0; key < 6; ++key)
+            EXPECT_TRUE(store.put(key, string(20, char('a' + key))));
+
+        EXPECT_EQ(4, store.size());
+        EXPECT_FALSE(store.contains(1));
+        EXPECT_EQ(2, store.statistics().dropped);
+
+        string value;
+        EXPECT_TRUE(store.get(5, value));
+        EXPECT_TRUE(value == string(20, 'f'));
+        EXPECT_TRUE(store.put(3, "new"));
+        EXPECT_TRUE(store.get(3, value));
+        EXPECT_TRUE(value == "new");
+        EXPECT_TRUE(store.take(3, value));
+        EXPECT_FALSE(store.contains(3));
+        EXPECT_FALSE(store.put(7, string(100, 'x')));
+        EXPECT_EQ(1, store.statistics().rejected);
+    };
+};
+
+// counts the keys built, lookups by int should not build any
+struct counted_key
+{
+    int value;
+    static int made;
+
+    explicit counted_key(int x): value(x) { ++made; }
+    counted_key(const counted_key& other): value(other.value) { ++made; }
+
+    friend std::ostream& operator<<(std::ostream& o, const counted_key& x) { return o << x.value; }
+};
+int counted_key::made = 0;
+
+struct counted_hash
+{
+    typedef void is_transparent;
+    std::size_t operator()(const counted_key& x) const { return std::hash<int>()(x.value); }
+    std::size_t operator()(int x) const { return std::hash<int>()(x); }
+};
+
+struct counted_equal
+{
+    typedef void is_transparent;
+    static int value_of(const counted_key& x) { return x.value; }
+    static int value_of(int x) { return x; }
+
+    template <class TLeft, class TRight>
+    bool operator()(const TLeft& x, const TRight& y) const { return value_of(x) == value_of(y); }
+};
+
+LTEST (transparent_lookup) {
+    using namespace std;
+
+    auto echo = [](const string& key) { return key.size(); };
+
+    limo::Cache<string, size_t, limo::LRU<string>, limo::FlatStorage, 
+        limo::StringHash, limo::StringEqual> cache(echo, 4);
+
+    EXPECT_EQ(3, cache["abc"]);
+    EXPECT_TRUE(cache.contains("abc"));
+    EXPECT_TRUE(cache.contains(string("abc")));
+    EXPECT_FALSE(cache.contains("ab"));
+    EXPECT_EQ(3, *cache.lookup("abc"));
+    EXPECT_EQ(1, cache.statistics().hits);
+
+    LTEST(string_hash) {
+        const string long_key(100, 'k');
+        EXPECT_EQ(limo::StringHash()(long_key), limo::StringHash()(long_key.c_str()));
+        EXPECT_TRUE(limo::StringEqual()(long_key, long_key.c_str()));
+        EXPECT_FALSE(limo::StringEqual()("abc", "abd"));
+    };
+
+    LTEST(key_built_on_miss_only) {
+        auto value_of = [](const counted_key& key) { return key.value * 10; };
+        limo::Cache<counted_key, int, limo::IntrusiveLRU<counted_key>, limo::FlatStorage, 
+            counted_hash, counted_equal> cache(value_of, 4, limo::IntrusiveLRU<counted_key>(4));
+
+        EXPECT_EQ(10, cache[1]);
+        const int after_miss = counted_key::made;
+        EXPECT_EQ(10, cache[1]);
+        EXPECT_EQ(10, *cache.lookup(1));
+        EXPECT_TRUE(cache.contains(1));
+        EXPECT_FALSE(cache.contains(2));
+        EXPECT_EQ(after_miss, counted_key::made);
+    };
+
+    LTEST(node_storage_converts) {
+        auto value_of = [](const counted_key& key) { return key.value; };
+        limo::Cache<counted_key, int, limo::LRU<counted_key>, limo::NodeStorage, 
+            counted_hash, counted_equal> cache(value_of, 4);
+        EXPECT_EQ(5, cache[5]);
+        EXPECT_TRUE(cache.contains(5));
+    };
+};
@@ -0,0 +1,472 @@
+#include "limo/test_main.hpp"
+#include <limo/profile.hpp>
+#include <limo/profile_allocations.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    const size_t all_lines = 1000;
+
+    const limo::profile::details::Info* info_of(
+        const std::vector<limo::profile::details::Info>& infos, const char* id)
+    {
+        for(const auto& info : infos)
+            if (std::strcmp(info.id, id) == 0)
+                return &info;
+        return nullptr;
+    }
+
+    void profiled_counter(int& x)
+    {
+        limo_profile_scope("profiled_counter");
+        ++x;
+    }
+
+    void profiled_worker()
+    {
+        limo_profile_scope("profiled_worker");
+    }
+
+    void profiled_inner()
+    {
+        limo_profile_scope("profiled_inner");
+    }
+
+    void profiled_outer()
+    {
+        limo_profile_scope("profiled_outer");
+        profiled_inner();
+        profiled_inner();
+    }
+
+    void profiled_recursion(int depth)
+    {
+        limo_profile_scope("profiled_recursion");
+        if (depth > 0)
+            profiled_recursion(depth - 1);
+    }
+
+    // ticks convert to durations with rounding
+    bool near(limo::profile::clock_type::duration x, limo::profile::clock_type::duration y)
+    {
+        return std::abs((x - y).count()) <= 2;
+    }
+
+    volatile std::uint64_t spin_sink = 0;
+
+    // burns CPU, the process timer of the sampler counts only that
+    void profiled_spin(std::chrono::milliseconds time)
+    {
+        limo_profile_scope("profiled_spin");
+        const auto until = std::chrono::steady_clock::now() + time;
+        while (std::chrono::steady_clock::now() < until)
+            spin_sink = spin_sink + 1;
+    }
+
+    int* volatile allocation_sink = nullptr;
+
+    void profiled_allocation_inner()
+    {
+        limo_profile_scope("profiled_allocation_inner");
+        allocation_sink = new int(1);
+        delete allocation_sink;
+    }
+
+    // one allocation of its own, one of the inner scope
+    void profiled_allocation(size_t n)
+    {
+        limo_profile_scope("profiled_allocation");
+        allocation_sink = new int[n];
+        delete[] allocation_sink;
+        profiled_allocation_inner();
+    }
+
+    size_t child_of(const limo::profile::details::CallTree& tree, size_t parent, const char* id)
+    {
+        for(auto child : tree[parent].children)
+            if (std::strcmp(tree[child].id, id) == 0)
+                return child;
+        return 0;
+    }
+}
+
+LTEST (profile) {
+    using namespace limo::profile;
+    using namespace limo::profile::details;
+
+    LTEST(counts_calls) {
+        int x = 0;
+        for(int i = 0; i < 100; ++i)
+            profiled_counter(x);
+
+        const auto infos = DB::results(all_lines);
+        const Info* info = info_of(infos, "profiled_counter");
+        EXPECT_TRUE(info != nullptr);
+        EXPECT_EQ(100u, info->calls);
+
+        std::ostringstream o;
+        results(o);
+        EXPECT_NE(std::string::npos, o.str().find("profiled_counter"));
+    };
+
+    LTEST(threads_merge) {
+        const int threads = 4;
+        const int calls = 10000;
+
+        std::vector<std::thread> workers;
+        for(int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([]() {
+                for(int i = 0; i < calls; ++i)
+                    profiled_worker();
+            });
+        }
+        for(auto& worker : workers)
+            worker.join();
+
+        const auto totals = DB::results(all_lines);
+        const Info* total = info_of(totals, "profiled_worker");
+        EXPECT_TRUE(total != nullptr);
+        EXPECT_EQ(size_t(threads * calls), total->calls);
+
+        int seen = 0;
+        for(const auto& thread : DB::thread_results(all_lines))
+        {
+            if (const Info* info = info_of(thread, "profiled_worker"))
+            {
+                EXPECT_EQ(size_t(calls), info->calls);
+                ++seen;
+            }
+        }
+        EXPECT_EQ(threads, seen);
+    };
+
+    LTEST(call_tree) {
+        for(int i = 0; i < 10; ++i)
+            profiled_outer();
+        profiled_inner();
+
+        const CallTree tree = DB::call_tree();
+        const size_t outer = child_of(tree, 0, "profiled_outer");
+        EXPECT_NE(0u, outer);
+        EXPECT_EQ(10u, tree[outer].calls);
+
+        const size_t nested = child_of(tree, outer, "profiled_inner");
+        EXPECT_NE(0u, nested);
+        EXPECT_EQ(20u, tree[nested].calls);
+        EXPECT_TRUE(near(tree[outer].inclusive, tree[outer].exclusive + tree[nested].inclusive));
+
+        const size_t top = child_of(tree, 0, "profiled_inner");
+        EXPECT_NE(0u, top);
+        EXPECT_EQ(1u, tree[top].calls);
+
+        const auto infos = DB::results(all_lines);
+        const Info* inner = info_of(infos, "profiled_inner");
+        EXPECT_EQ(21u, inner->calls);
+        EXPECT_TRUE(near(inner->total_time, tree[nested].inclusive + tree[top].inclusive));
+    };
+
+    LTEST(recursion_keeps_one_node) {
+        profiled_recursion(5);
+
+        const CallTree tree = DB::call_tree();
+        const size_t node = child_of(tree, 0, "profiled_recursion");
+        EXPECT_NE(0u, node);
+        EXPECT_TRUE(tree[node].children.empty());
+        EXPECT_EQ(6u, tree[node].calls);
+        EXPECT_TRUE(near(tree[node].inclusive, tree[node].exclusive));
+
+        std::ostringstream o;
+        results(o);
+        EXPECT_NE(std::string::npos, o.str().find("call tree"));
+    };
+
+    LTEST(overhead_subtracted) {
+        ThreadData thread(0, Overhead{10, 25});
+        Frame outer, inner;
+
+        thread.enter(outer, 0);
+        for(int i = 0; i < 2; ++i)
+        {
+            thread.enter(inner, 1);
+            thread.leave(inner, 40);        // 30 after the clock reads
+        }
+        thread.leave(outer, 200);           // 200 - 10 - 2 * 25 = 140
+
+        const Node& x = thread.node(1);
+        const Node& y = thread.node(2);
+        EXPECT_EQ(140, x.inclusive.get());
+        EXPECT_EQ(80, x.exclusive.get());
+        EXPECT_EQ(60, y.inclusive.get());
+
+        thread.enter(outer, 0);
+        thread.enter(inner, 1);
+        thread.leave(inner, 5);             // never below zero
+        thread.leave(outer, 20);            // nor below its children
+        EXPECT_EQ(60, y.inclusive.get());
+        EXPECT_EQ(60, y.exclusive.get());
+        EXPECT_EQ(140, x.inclusive.get());
+        EXPECT_EQ(80, x.exclusive.get());
+
+        const Overhead overhead = DB::overhead();
+        EXPECT_LE(0, overhead.inner);
+        EXPECT_LE(overhead.inner, overhead.outer);
+    };
+
+    LTEST(histogram_layout) {
+        typedef HistogramLayout layout;
+
+        bool ordered = true;
+        bool precise = true;
+        for(std::int64_t x = 0; x < (std::int64_t(1) << 24); x = x * 9 / 8 + 1)
+        {
+            const size_t i = layout::index(x);
+            ordered &= layout::highest(i) >= x && (i == 0 || layout::highest(i - 1) < x);
+            precise &= layout::highest(i) - x <= x / std::int64_t(layout::sub_buckets);
+        }
+        EXPECT_TRUE(ordered);
+        EXPECT_TRUE(precise);
+        EXPECT_EQ(layout::buckets - 1, layout::index(std::int64_t(1) << 50));
+        EXPECT_EQ(0u, layout::index(-5));
+    };
+
+    LTEST(percentiles) {
+        ThreadHistogram thread;
+        for(std::int64_t x = 1; x <= 1000; ++x)
+            thread.record(x);
+
+        Histogram latency;
+        latency.add(thread);
+        EXPECT_EQ(1000u, latency.count());
+        EXPECT_EQ(1000, latency.max);
+        EXPECT_EQ(1000, latency.percentile(100));
+        EXPECT_EQ(1, latency.percentile(0));
+
+        const auto p50 = latency.percentile(50);
+        const auto p99 = latency.percentile(99);
+        EXPECT_TRUE(500 <= p50 && p50 <= 500 + 500 / 16);
+        EXPECT_TRUE(990 <= p99 && p99 <= 1000);
+
+        const auto infos = DB::results(all_lines);
+        const Info* info = info_of(infos, "profiled_counter");
+        EXPECT_EQ(info->calls, info->latency.count());
+        EXPECT_LE(info->percentile<std::chrono::nanoseconds>(50), info->max<std::chrono::nanoseconds>());
+    };
+
+    LTEST(event_ring) {
+        EventRing ring(3);
+        EXPECT_EQ(4u, ring.capacity());
+
+        for(std::uint32_t i = 0; i < 10; ++i)
+            ring.push(EventRing::Event{i, 0, i, i + 1});
+        EXPECT_EQ(6u, ring.dropped());
+
+        std::vector<EventRing::Event> events;
+        EXPECT_EQ(4u, ring.drain(events));
+        EXPECT_EQ(0u, ring.drain(events));
+        EXPECT_TRUE(ring.push(EventRing::Event{10, 0, 10, 11}));
+        EXPECT_EQ(1u, ring.drain(events));
+
+        std::vector<std::int64_t> begins;
+        for(const auto& x : events)
+            begins.push_back(x.begin);
+        EXPECT_TRUE(begins == std::vector<std::int64_t>({0, 1, 2, 3, 10}));
+    };
+
+    LTEST(event_ring_threads) {
+        EventRing ring(64);
+        const std::uint32_t count = 100000;
+
+        std::thread producer([&ring]() {
+            for(std::uint32_t i = 0; i < count; ++i)
+                ring.push(EventRing::Event{i, 0, i, i});
+        });
+
+        std::vector<EventRing::Event> events;
+        while (events.size() + ring.dropped() < count)
+            ring.drain(events);
+        producer.join();
+        ring.drain(events);
+
+        bool ordered = true;
+        for(size_t i = 1; i < events.size(); ++i)
+            ordered &= events[i - 1].scope < events[i].scope;
+        EXPECT_TRUE(ordered);
+        EXPECT_EQ(size_t(count), events.size() + ring.dropped());
+    };
+
+    LTEST(exports) {
+        const size_t dropped = DB::timeline_dropped();
+        start_timeline(16);
+        for(int i = 0; i < 100; ++i)
+            profiled_outer();
+        stop_timeline();
+        profiled_outer();
+
+        const auto events = DB::timeline();
+        EXPECT_LE(16u, events.size());
+        EXPECT_EQ(300u, events.size() + DB::timeline_dropped() - dropped);
+        bool ordered = true;
+        for(size_t i = 1; i < events.size(); ++i)
+            ordered &= events[i - 1].begin <= events[i].begin;
+        EXPECT_TRUE(ordered);
+
+        std::ostringstream trace;
+        chrome_trace(trace);
+        EXPECT_EQ(0u, trace.str().find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+        EXPECT_NE(std::string::npos, trace.str().find("\"otherData\":{\"dropped\":"));
+        EXPECT_NE(std::string::npos, trace.str().find("{\"name\":\"profiled_inner\",\"ph\":\"X\""));
+
+        std::ostringstream table;
+        csv(table);
+        EXPECT_EQ(0u, table.str().find("thread,id,calls,total_ns,self_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n"));
+        EXPECT_NE(std::string::npos, table.str().find("all,\"profiled_outer\","));
+
+        std::ostringstream object;
+        json(object);
+        EXPECT_EQ(0u, object.str().find("{\"scopes\":["));
+        EXPECT_NE(std::string::npos, object.str().find("\"call_tree\":{\"id\":null"));
+
+        std::ostringstream escaped;
+        write_json_string(escaped, "a\"b\\c\n");
+        EXPECT_EQ("\"a\\\"b\\\\c\\u000a\"", escaped.str());
+    };
+
+    LTEST(samples_innermost) {
+        ThreadData thread(0);
+        Frame outer, inner;
+
+        thread.sample();
+        thread.enter(outer, 0);
+        thread.sample();
+        thread.enter(inner, 1);
+        thread.sample();
+        thread.sample();
+        thread.leave(inner, 1);
+        thread.leave(outer, 2);
+
+        EXPECT_EQ(1u, thread.node(ThreadData::root).samples.get());
+        EXPECT_EQ(1u, thread.node(1).samples.get());
+        EXPECT_EQ(2u, thread.node(2).samples.get());
+    };
+
+    #if defined(LIMO_PROFILE_HAS_SAMPLING)
+    LTEST(sampling) {
+        EXPECT_TRUE(start_sampling(1000));
+        profiled_spin(std::chrono::milliseconds(200));
+        stop_sampling();
+        EXPECT_EQ(0u, Sampler::frequency());
+
+        const auto infos = DB::results(all_lines);
+        const Info* info = info_of(infos, "profiled_spin");
+        EXPECT_TRUE(info != nullptr);
+        EXPECT_GT(info->samples, 0u);
+
+        EXPECT_FALSE(start_sampling(0));
+
+        // a whole second period
+        EXPECT_TRUE(start_sampling(1));
+        EXPECT_EQ(1u, Sampler::frequency());
+        stop_sampling();
+    };
+    #endif
+
+    LTEST(counters_added_once) {
+        ThreadData thread(0);
+        Frame outer, inner;
+        CounterGroup::values_type now = {};
+
+        thread.enter(outer, 0);
+        outer.counters = {{100, 200, 3, 2, 1}};
+        thread.enter(inner, 0);
+        inner.counters = {{150, 250, 3, 2, 1}};
+        now = {{160, 270, 4, 2, 1}};
+        thread.count(inner, now);
+        thread.leave(inner, 1);
+        now = {{200, 400, 5, 3, 1}};
+        thread.count(outer, now);
+        thread.leave(outer, 2);
+
+        EXPECT_EQ(100u, thread.node(1).counters[counter_cycles].get());
+        EXPECT_EQ(200u, thread.node(1).counters[counter_instructions].get());
+        EXPECT_EQ(2u, thread.node(1).counters[counter_l1_misses].get());
+        EXPECT_EQ(0u, thread.node(1).counters[counter_branch_misses].get());
+    };
+
+    LTEST(counters) {
+        CounterGroup group;
+        CounterGroup::values_type first = {}, second = {};
+        if (group.is_open())
+        {
+            EXPECT_TRUE(group.read(first));
+            profiled_spin(std::chrono::milliseconds(1));
+            EXPECT_TRUE(group.read(second));
+            if (group.mask() & (1u << counter_instructions))
+                EXPECT_GT(second[counter_instructions], first[counter_instructions]);
+        }
+        else
+        {
+            EXPECT_EQ(0u, group.mask());
+            EXPECT_FALSE(group.read(first));
+        }
+
+        const bool counting = start_counters();
+        EXPECT_EQ(group.is_open(), counting);
+        profiled_spin(std::chrono::milliseconds(1));
+        stop_counters();
+        EXPECT_FALSE(DB::counters_enabled());
+
+        const auto infos = DB::results(all_lines);
+        const Info* info = info_of(infos, "profiled_spin");
+        EXPECT_TRUE(info != nullptr);
+        if (counting)
+            EXPECT_NE(0u, info->counter_mask);
+
+        std::ostringstream report;
+        results(report);
+        EXPECT_EQ(counting, report.str().find("IPC") != std::string::npos);
+    };
+
+    LTEST(allocations) {
+        EXPECT_TRUE(DB::allocations_tracked().load());
+
+        for(int i = 0; i < 4; ++i)
+            profiled_allocation(10);
+
+        const auto infos = DB::results(all_lines);
+        const Info* outer = info_of(infos, "profiled_allocation");
+        const Info* inner = info_of(infos, "profiled_allocation_inner");
+        EXPECT_TRUE(outer != nullptr && inner != nullptr);
+        EXPECT_EQ(4u, outer->allocations);
+        EXPECT_EQ(4 * 10 * sizeof(int), outer->bytes);
+        EXPECT_EQ(1.0, outer->allocations_per_call());
+        EXPECT_EQ(4u, inner->allocations);
+        EXPECT_EQ(double(sizeof(int)), inner->bytes_per_call());
+
+        std::ostringstream report;
+        results(report);
+        EXPECT_NE(std::string::npos, report.str().find("allocs/call"));
+    };
+
+    LTEST(ticks) {
+        const auto second = Ticks::to_duration(std::int64_t(Ticks::frequency()));
+        EXPECT_LT(std::abs(std::chrono::duration<double>(second).count() - 1), 0.01);
+
+        #if defined(LIMO_PROFILE_HAS_TSC)
+            EXPECT_GT(TscTicks::frequency(), 0);
+            const auto start = TscTicks::start();
+            EXPECT_LE(start, TscTicks::stop());
+        #endif
+    };
+};
+
+//------------------------------------------------------------------------------